@@ -0,0 +1,125 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "animation.h"
+
+void Animation::play( const AnimationTrack *animationTrack, u32 time )
+{
+	track = animationTrack;
+	startTime = time;
+	endTime = track->duration;
+
+	if ( track->padOffsets )
+	{
+		u32 maxOffset = 0;
+
+		for ( i32 i = 0; i < RGBKeypad::NUM_PADS; ++i )
+		{
+			if ( track->padOffsets[ i ] > maxOffset )
+				maxOffset = track->padOffsets[ i ];
+		}
+
+		endTime += maxOffset;
+	}
+
+	memset( padKeyframes, NO_KEYFRAME, sizeof( padKeyframes ) );
+}
+
+void Animation::stop()
+{
+	track = nullptr;
+}
+
+bool Animation::is_playing()
+{
+	return track != nullptr;
+}
+
+bool Animation::update( Layer *layer, u32 time )
+{
+	if ( !track )
+		return false;
+
+	u32 elapsed = time - startTime;
+
+	if ( elapsed >= endTime )
+	{
+		track = nullptr;
+		return false;
+	}
+
+	const Keyframe *keyframes = track->keyframes;
+	i32 last = track->keyframeCount - 1;
+
+	for ( i32 pad = 0; pad < RGBKeypad::NUM_PADS; ++pad )
+	{
+		u32 offset = track->padOffsets ? track->padOffsets[ pad ] : 0;
+		u32 padTime = elapsed > offset ? elapsed - offset : 0;
+
+		// Keyframe the pad is in, the tracks are short so a scan is fine
+		i32 k = 0;
+
+		while ( k < last && padTime >= keyframes[ k + 1 ].time )
+			++k;
+
+		const Keyframe &a = keyframes[ k ];
+
+		if ( !track->interpolate || k == last )
+		{
+			// Holding a keyframe it already shows, nothing to do
+			if ( padKeyframes[ pad ] == k )
+				continue;
+
+			padKeyframes[ pad ] = static_cast<u8>( k );
+			layer->set_colour_raw( pad, a.colour, a.brightness );
+			continue;
+		}
+
+		const Keyframe &b = keyframes[ k + 1 ];
+		u32 fraction = ( ( padTime - a.time ) << 8 ) / ( b.time - a.time );
+
+		padKeyframes[ pad ] = NO_KEYFRAME;
+
+		layer->set_pad( pad, packed_lerp_q8( pack_colour( a.colour, a.brightness ), pack_colour( b.colour, b.brightness ), fraction ) );
+	}
+
+	return true;
+}
+
+void Crossfade::start( const u8 fromFrame[ RGBKeypad::FRAME_SIZE ], const RGBKeypad::Frame &toFrame, u32 fadeDuration, u32 time )
+{
+	memcpy( from, fromFrame, RGBKeypad::FRAME_SIZE );
+	memcpy( to, toFrame.data, RGBKeypad::FRAME_SIZE );
+	startTime = time;
+	duration = fadeDuration;
+	active = true;
+}
+
+void Crossfade::stop()
+{
+	active = false;
+}
+
+bool Crossfade::update( Layer *layer, u32 time )
+{
+	if ( !active )
+		return false;
+
+	u32 elapsed = time - startTime;
+
+	if ( elapsed >= duration )
+	{
+		layer->set_frame( to );
+		active = false;
+		return false;
+	}
+
+	u32 fraction = ( elapsed << 8 ) / duration;
+
+	PackedColour frame[ RGBKeypad::NUM_PADS ];
+	colour_span_lerp_q8( frame, from, to, fraction, RGBKeypad::NUM_PADS );
+
+	layer->set_frame( frame );
+
+	return true;
+}
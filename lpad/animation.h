@@ -0,0 +1,54 @@
+#pragma once
+
+#include "types.h"
+#include "compositor.h"
+
+struct Keyframe
+{
+	u32 time;										// us from the start of the track
+	Colour colour;
+	u8 brightness;									// raw 5 bit
+};
+
+// Defined at compile time, every pad plays the same keyframes shifted by its offset
+struct AnimationTrack
+{
+	const Keyframe *keyframes;
+	u8 keyframeCount;
+	u32 duration;									// us
+	bool interpolate;								// false holds each keyframe until the next one
+	const u32 *padOffsets;							// us per pad, nullptr for none
+};
+
+struct Animation
+{
+	static constexpr u8 NO_KEYFRAME = 0xFF;
+
+	const AnimationTrack *track;
+	u32 startTime;									// us
+	u32 endTime;									// us after the start, includes the largest pad offset
+	u8 padKeyframes[ RGBKeypad::NUM_PADS ];			// keyframe each pad was last holding
+
+	void play( const AnimationTrack *track, u32 time );
+	void stop();
+	bool is_playing();
+
+	// Returns false once the track has finished
+	bool update( Layer *layer, u32 time );
+};
+
+// Fades every pad from one frame to another
+struct Crossfade
+{
+	PackedColour from[ RGBKeypad::NUM_PADS ];
+	PackedColour to[ RGBKeypad::NUM_PADS ];
+	u32 startTime;									// us
+	u32 duration;									// us
+	bool active;
+
+	void start( const u8 from[ RGBKeypad::FRAME_SIZE ], const RGBKeypad::Frame &to, u32 duration, u32 time );
+	void stop();
+
+	// Returns false once the fade has finished
+	bool update( Layer *layer, u32 time );
+};
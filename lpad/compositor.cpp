@@ -0,0 +1,185 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "compositor.h"
+
+static constexpr i32 NUM_PADS = RGBKeypad::NUM_PADS;
+
+static constexpr LayerPlanes blackPlanes = {};
+
+void Layer::clear()
+{
+	memset( &planes, 0, sizeof( planes ) );
+	pads = 0;
+	dirty = true;
+}
+
+void Layer::set_alpha( u16 layerAlpha )
+{
+	if ( layerAlpha > OPAQUE || layerAlpha == alpha )
+		return;
+
+	alpha = layerAlpha;
+	dirty = true;
+}
+
+void Layer::set_pad( i32 index, PackedColour colour )
+{
+	if ( index < 0 || index >= NUM_PADS )
+		return;
+
+	Colour rgb = unpack_colour( colour );
+	u8 brightness = packed_brightness( colour );
+	RGBKeypad::PadMask bit = RGBKeypad::PadMask( 1 ) << index;
+
+	if ( ( pads & bit ) && planes.r[ index ] == rgb.r && planes.g[ index ] == rgb.g && planes.b[ index ] == rgb.b && planes.brightness[ index ] == brightness )
+		return;
+
+	planes.r[ index ] = rgb.r;
+	planes.g[ index ] = rgb.g;
+	planes.b[ index ] = rgb.b;
+	planes.brightness[ index ] = brightness;
+	pads |= bit;
+	dirty = true;
+}
+
+void Layer::set_colour( Colour colour )
+{
+	memset( planes.r, colour.r, sizeof( planes.r ) );
+	memset( planes.g, colour.g, sizeof( planes.g ) );
+	memset( planes.b, colour.b, sizeof( planes.b ) );
+	dirty = true;
+}
+
+void Layer::set_colour_raw( i32 index, Colour colour, u8 brightness )
+{
+	set_pad( index, pack_colour( colour, brightness ) );
+}
+
+void Layer::set_frame( const RGBKeypad::Frame &frame )
+{
+	for ( i32 i = 0; i < NUM_PADS; ++i )
+	{
+		const u8 *pad = &frame.data[ i * 4 ];
+
+		planes.brightness[ i ] = pad[ 0 ] & 0b00011111;
+		planes.b[ i ] = pad[ 1 ];
+		planes.g[ i ] = pad[ 2 ];
+		planes.r[ i ] = pad[ 3 ];
+	}
+
+	pads = RGBKeypad::ALL_PADS;
+	dirty = true;
+}
+
+void Layer::set_frame( const PackedColour ( &frame )[ RGBKeypad::NUM_PADS ] )
+{
+	for ( i32 i = 0; i < NUM_PADS; ++i )
+	{
+		Colour rgb = unpack_colour( frame[ i ] );
+
+		planes.r[ i ] = rgb.r;
+		planes.g[ i ] = rgb.g;
+		planes.b[ i ] = rgb.b;
+		planes.brightness[ i ] = packed_brightness( frame[ i ] );
+	}
+
+	pads = RGBKeypad::ALL_PADS;
+	dirty = true;
+}
+
+// below -> above by a Q8 alpha per pad, rounds the same as packed_lerp_q8
+static void blend_plane( u8 *out, const u8 *below, const u8 *above, const u16 *alphas )
+{
+	for ( i32 i = 0; i < NUM_PADS; ++i )
+	{
+		out[ i ] = static_cast<u8>( ( below[ i ] * ( Layer::OPAQUE - alphas[ i ] ) + above[ i ] * alphas[ i ] ) >> 8 );
+	}
+}
+
+static void blend_layer( LayerPlanes *out, const LayerPlanes *below, const Layer &layer )
+{
+	// Nothing drawn shows the layers below, drawn over every pad replaces them
+	if ( layer.pads == 0 || layer.alpha == 0 )
+	{
+		memcpy( out, below, sizeof( LayerPlanes ) );
+		return;
+	}
+
+	if ( layer.pads == RGBKeypad::ALL_PADS && layer.alpha == Layer::OPAQUE )
+	{
+		memcpy( out, &layer.planes, sizeof( LayerPlanes ) );
+		return;
+	}
+
+	u16 alphas[ NUM_PADS ];
+
+	for ( i32 i = 0; i < NUM_PADS; ++i )
+	{
+		alphas[ i ] = ( layer.pads >> i ) & 1 ? layer.alpha : 0;
+	}
+
+	blend_plane( out->r, below->r, layer.planes.r, alphas );
+	blend_plane( out->g, below->g, layer.planes.g, alphas );
+	blend_plane( out->b, below->b, layer.planes.b, alphas );
+	blend_plane( out->brightness, below->brightness, layer.planes.brightness, alphas );
+}
+
+void Compositor::init()
+{
+	for ( i32 i = 0; i < LAYER_COUNT; ++i )
+	{
+		layers[ i ].alpha = Layer::OPAQUE;
+		layers[ i ].clear();
+	}
+
+	memset( composited, 0, sizeof( composited ) );
+
+	flushes = 0;
+	flushesSkipped = 0;
+	layersBlended = 0;
+}
+
+void Compositor::clear()
+{
+	for ( i32 i = 0; i < LAYER_COUNT; ++i )
+	{
+		layers[ i ].clear();
+	}
+}
+
+bool Compositor::flush( RGBKeypad *keypad )
+{
+	// The layers below the lowest changed one are still composited from last time
+	i32 lowest = 0;
+
+	while ( lowest < LAYER_COUNT && !layers[ lowest ].dirty )
+		++lowest;
+
+	if ( lowest == LAYER_COUNT )
+	{
+		flushesSkipped += 1;
+		return false;
+	}
+
+	for ( i32 i = lowest; i < LAYER_COUNT; ++i )
+	{
+		blend_layer( &composited[ i ], i > 0 ? &composited[ i - 1 ] : &blackPlanes, layers[ i ] );
+		layers[ i ].dirty = false;
+		layersBlended += 1;
+	}
+
+	// Packed into wire order once, the keypad only marks the pads that differ
+	const LayerPlanes &top = composited[ LAYER_COUNT - 1 ];
+	PackedColour frame[ NUM_PADS ];
+
+	for ( i32 i = 0; i < NUM_PADS; ++i )
+	{
+		frame[ i ] = pack_colour( { top.r[ i ], top.g[ i ], top.b[ i ] }, top.brightness[ i ] );
+	}
+
+	keypad->set_frame( frame );
+	flushes += 1;
+
+	return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "types.h"
+#include "packed_colour.h"
+#include "rgb_keypad.h"
+
+// Bottom to top
+enum class LAYER
+{
+	BACKGROUND,										// the mode's theme, the selection row and keys
+	CONTENT,										// what the mode is showing, game lights
+	OVERLAY,										// transient, animations and notifications
+	COUNT,
+};
+
+constexpr i32 LAYER_COUNT = static_cast<i32>( LAYER::COUNT );
+
+// A channel per plane, so blending walks each one straight through
+struct LayerPlanes
+{
+	u8 r[ RGBKeypad::NUM_PADS ];
+	u8 g[ RGBKeypad::NUM_PADS ];
+	u8 b[ RGBKeypad::NUM_PADS ];
+	u8 brightness[ RGBKeypad::NUM_PADS ];			// raw 5 bit
+};
+
+struct Layer
+{
+	static constexpr u16 OPAQUE = 256;
+
+	LayerPlanes planes;
+	RGBKeypad::PadMask pads;						// pads this layer draws, the rest show what is below
+	u16 alpha;										// Q8 (0-256) over the layers below
+	bool dirty;										// changed since it was last composited
+
+	void clear();
+	void set_alpha( u16 alpha );
+
+	void set_pad( i32 index, PackedColour colour );
+	void set_colour( Colour colour );				// every drawn pad, each keeps its brightness
+	void set_colour_raw( i32 index, Colour colour, u8 brightness );
+	void set_frame( const RGBKeypad::Frame &frame );
+	void set_frame( const PackedColour ( &frame )[ RGBKeypad::NUM_PADS ] );
+
+	[[nodiscard]] u8 get_brightness_raw( i32 index ) const { return planes.brightness[ index ]; }
+};
+
+// Stacks the layers with integer alpha and packs the result into the keypad's wire format
+// once per flush. Each layer below the lowest changed one is kept composited, so only the
+// layers that changed and those above them are blended again.
+struct Compositor
+{
+	Layer layers[ LAYER_COUNT ];
+	LayerPlanes composited[ LAYER_COUNT ];			// every layer up to and including this one
+	u32 flushes;
+	u32 flushesSkipped;								// nothing changed
+	u32 layersBlended;
+
+	void init();
+	void clear();									// every layer
+
+	Layer *layer( LAYER index ) { return &layers[ static_cast<i32>( index ) ]; }
+
+	// Returns false if nothing changed and the keypad was left alone
+	bool flush( RGBKeypad *keypad );
+};
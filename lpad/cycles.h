@@ -0,0 +1,27 @@
+#pragma once
+
+#include "hardware/structs/systick.h"
+
+#include "types.h"
+
+// SysTick as a free running cpu cycle counter. It is per core and only 24 bits,
+// so it is good for spans up to ~134ms at 125MHz.
+constexpr u32 CYCLES_MASK = 0x00FFFFFF;
+
+inline void cycles_init()
+{
+	systick_hw->rvr = CYCLES_MASK;
+	systick_hw->cvr = 0;
+	systick_hw->csr = 0b101;						// enabled, counting the processor clock
+}
+
+[[nodiscard]] inline u32 cycles_now()
+{
+	return systick_hw->cvr;
+}
+
+// SysTick counts down
+[[nodiscard]] inline u32 cycles_since( u32 start )
+{
+	return ( start - systick_hw->cvr ) & CYCLES_MASK;
+}
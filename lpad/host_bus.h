@@ -0,0 +1,174 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+
+#include "types.h"
+
+// One tca9555 on the mock bus
+struct HostExpander
+{
+	static constexpr u8 NO_POINTER = 0xFF;
+
+	std::vector<u16> buttonScript;					// pressed keys, one entry per read, the last one repeats
+	u32 buttonScriptIndex;
+	u32 failReads;									// fail (nack) this many transactions before answering
+	u8 pointer;										// command register, reads return the register pair it points at
+	u32 reads;
+	u32 pointerWrites;
+};
+
+// Stands in for the rp2040 bus when building for a host, so the led and input code
+// can be tested and benchmarked off target. Every spi write is recorded and each
+// expander address serves its own script of button states.
+struct HostBus
+{
+	static constexpr i32 NO_INTERRUPT_PIN = -1;
+	static constexpr u8 EXPANDER_ADDRESS = 0x20;	// first address that answers, one expander per address after it
+	static constexpr i32 MAX_EXPANDERS = 8;
+
+	std::vector<std::vector<u8>> spiFrames;
+	HostExpander expanders[ MAX_EXPANDERS ];
+	u32 time;										// us, advanced by the test
+	u32 i2cRecoveries;
+	bool sdaHeld;									// a slave stuck mid byte, until the bus is recovered
+
+	void init( u32 i2cSpeed, i32 expanderInterruptPin )
+	{
+		(void) i2cSpeed;
+		(void) expanderInterruptPin;
+
+		spiFrames.clear();
+		time = 0;
+		i2cRecoveries = 0;
+		sdaHeld = false;
+
+		// Scripts are kept, a test can set them before or after the keypad's init
+		for ( HostExpander &expander : expanders )
+		{
+			expander.buttonScriptIndex = 0;
+			expander.failReads = 0;
+			expander.pointer = HostExpander::NO_POINTER;
+			expander.reads = 0;
+			expander.pointerWrites = 0;
+		}
+	}
+
+	void free()
+	{
+	}
+
+	[[nodiscard]] u32 time_us()
+	{
+		return time;
+	}
+
+	// Nanoseconds stand in for cycles on the host
+	[[nodiscard]] u32 cycles_now()
+	{
+		return static_cast<u32>( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count() );
+	}
+
+	[[nodiscard]] u32 cycles_since( u32 start )
+	{
+		return cycles_now() - start;
+	}
+
+	void spi_write_async( const u8 *data, u32 size )
+	{
+		spiFrames.emplace_back( data, data + size );
+	}
+
+	[[nodiscard]] bool spi_busy()
+	{
+		return false;
+	}
+
+	// The expander at an address, nullptr if nothing would ack it (or it is set to fail)
+	HostExpander *answer( u8 address )
+	{
+		if ( address < EXPANDER_ADDRESS || address >= EXPANDER_ADDRESS + MAX_EXPANDERS )
+			return nullptr;
+
+		HostExpander *expander = &expanders[ address - EXPANDER_ADDRESS ];
+
+		if ( expander->failReads > 0 )
+		{
+			expander->failReads -= 1;
+			return nullptr;
+		}
+
+		return expander;
+	}
+
+	[[nodiscard]] bool i2c_write( u8 address, const u8 *data, u32 size )
+	{
+		HostExpander *expander = answer( address );
+
+		if ( !expander || size == 0 )
+			return false;
+
+		expander->pointer = data[ 0 ];
+		expander->pointerWrites += 1;
+
+		return true;
+	}
+
+	[[nodiscard]] u32 i2c_read_batch( const u8 *addresses, u32 count, u8 *data, u32 size )
+	{
+		u32 answered = 0;
+
+		for ( u32 i = 0; i < count; ++i )
+		{
+			HostExpander *expander = answer( addresses[ i ] );
+
+			if ( !expander )
+				continue;
+
+			u16 pressed = 0;
+
+			if ( !expander->buttonScript.empty() )
+			{
+				u32 index = expander->buttonScriptIndex < expander->buttonScript.size() ? expander->buttonScriptIndex : static_cast<u32>( expander->buttonScript.size() - 1 );
+				pressed = expander->buttonScript[ index ];
+				expander->buttonScriptIndex += 1;
+			}
+
+			// The inputs are pulled up, a pressed key reads as 0. Any other register reads as
+			// 0 here, every key pressed, so a read without the pointer set shows up in tests.
+			u16 port = expander->pointer <= 1 ? static_cast<u16>( ~pressed ) : 0;
+
+			if ( expander->pointer == 1 )
+				port = static_cast<u16>( ( port >> 8 ) | ( port << 8 ) );
+
+			for ( u32 b = 0; b < size; ++b )
+				data[ i * size + b ] = static_cast<u8>( port >> ( b * 8 ) );
+
+			expander->reads += 1;
+			answered |= 1u << i;
+		}
+
+		return answered;
+	}
+
+	[[nodiscard]] bool i2c_sda_low()
+	{
+		return sdaHeld;
+	}
+
+	void i2c_recover()
+	{
+		i2cRecoveries += 1;
+		sdaHeld = false;
+	}
+
+	[[nodiscard]] bool input_changed()
+	{
+		return true;
+	}
+
+	void input_retry()
+	{
+	}
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+// The bus RGBKeypad reaches the hardware through, picked at compile time so
+// there is no virtual call cost. Define LPAD_HOST to build against the host mock.
+#ifdef LPAD_HOST
+	#include "host_bus.h"
+	using KeypadBus = HostBus;
+#else
+	#include "rp2040_bus.h"
+	using KeypadBus = Rp2040Bus;
+#endif
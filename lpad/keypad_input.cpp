@@ -0,0 +1,94 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "keypad_input.h"
+
+void KeypadInput::init( RGBKeypad *inputKeypad, u32 inputSampleRate )
+{
+	keypad = inputKeypad;
+	sampleRate = inputSampleRate;
+	lastSampleTime = keypad->bus.time_us();
+	keysDown = 0;
+	keysSettling = 0;
+	eventsDropped = 0;
+
+	events.init();
+
+	memset( integrators, 0, sizeof( integrators ) );
+}
+
+bool KeypadInput::update()
+{
+	u32 time = keypad->bus.time_us();
+
+	if ( time - lastSampleTime < sampleRate )
+		return false;
+
+	lastSampleTime = time;
+
+	sample( time );
+
+	return true;
+}
+
+void KeypadInput::sample( u32 time )
+{
+	RGBKeypad::PadMask raw = keypad->get_button_states();
+
+	// Every key is settled and agrees with the raw state
+	if ( raw == keysDown && !keysSettling )
+		return;
+
+	keysSettling = 0;
+
+	for ( i32 key = 0; key < RGBKeypad::NUM_PADS; ++key )
+	{
+		RGBKeypad::PadMask bit = RGBKeypad::PadMask( 1 ) << key;
+		u8 &integrator = integrators[ key ];
+
+		if ( raw & bit )
+		{
+			if ( integrator < DEBOUNCE_SAMPLES )
+			{
+				integrator += 1;
+
+				if ( integrator == DEBOUNCE_SAMPLES && !( keysDown & bit ) )
+				{
+					keysDown |= bit;
+					push( time, key, true );
+				}
+			}
+		}
+		else
+		{
+			if ( integrator > 0 )
+			{
+				integrator -= 1;
+
+				if ( integrator == 0 && ( keysDown & bit ) )
+				{
+					keysDown &= ~bit;
+					push( time, key, false );
+				}
+			}
+		}
+
+		if ( integrator != 0 && integrator != DEBOUNCE_SAMPLES )
+		{
+			keysSettling |= bit;
+		}
+	}
+}
+
+void KeypadInput::push( u32 time, u8 key, bool pressed )
+{
+	if ( !events.push( { .time = time, .keysDown = keysDown, .key = key, .pressed = pressed } ) )
+	{
+		eventsDropped += 1;
+	}
+}
+
+bool KeypadInput::pop( KeyEvent *event )
+{
+	return events.pop( event );
+}
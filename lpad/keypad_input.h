@@ -0,0 +1,35 @@
+#pragma once
+
+#include "types.h"
+#include "rgb_keypad.h"
+#include "spsc_ring.h"
+
+struct KeyEvent
+{
+	u32 time;										// us, when the debounced state changed
+	RGBKeypad::PadMask keysDown;					// debounced state after this event
+	u8 key;
+	bool pressed;
+};
+
+struct KeypadInput
+{
+	static constexpr u32 DEFAULT_SAMPLE_RATE = 1000;		// us
+	static constexpr u8 DEBOUNCE_SAMPLES = 5;				// samples a key must agree for before it changes
+	static constexpr u32 MAX_EVENTS = 32;
+
+	RGBKeypad *keypad;
+	u32 sampleRate;									// us
+	u32 lastSampleTime;
+	u8 integrators[ RGBKeypad::NUM_PADS ];
+	RGBKeypad::PadMask keysDown;
+	RGBKeypad::PadMask keysSettling;				// keys whose integrator is between up and down
+	SpscRing<KeyEvent, MAX_EVENTS> events;			// pushed by the sampling core, popped by the app
+	u32 eventsDropped;
+
+	void init( RGBKeypad *keypad, u32 sampleRate = DEFAULT_SAMPLE_RATE );
+	bool update();
+	void sample( u32 time );
+	void push( u32 time, u8 key, bool pressed );
+	bool pop( KeyEvent *event );
+};
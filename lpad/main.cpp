@@ -6,15 +6,20 @@
 #include "pico/stdlib.h"
 #include "pico/rand.h" 
 #include "pico/util/queue.h"
+#include "pico/multicore.h"
 #include "hardware/watchdog.h"
 #include "bsp/board.h"
 #include "tusb.h"
 #include "usb_descriptors.h"
 #include "rgb_keypad.h"
+#include "keypad_input.h"
+#include "animation.h"
+#include "compositor.h"
+#include "spsc_ring.h"
+#include "cycles.h"
 #include "random.h"
 #include "utility.h"
-
-#define ARRAY_LENGTH( arr )		( sizeof( arr ) / sizeof( arr[ 0 ] ) )
+#include "photon_smash.h"
 
 template <typename T>
 T min( T a, T b )
@@ -82,6 +87,16 @@ constexpr PhotonSmashPredefinedLevel photonSmashPredefinedLevels[] =
 	},
 };
 
+static constexpr u16 photon_smash_level_board( const PhotonSmashPredefinedLevel &level )
+{
+	u16 board = 0;
+
+	for ( i32 i = 0; i < level.lightsCount; ++i )
+		board |= 1 << level.lights[ i ];
+
+	return board;
+}
+
 enum
 {
 	 KEY_0 = ( 1 << 0 ),
@@ -103,6 +118,20 @@ enum
 };
 
 constexpr u32 MAX_KEY_QUEUE_ELEMENTS = 16;
+constexpr u32 MAX_LED_FRAMES = 2;
+constexpr u32 CORE1_READY = 0xC0DE0001;
+constexpr u32 CORE_LOAD_WINDOW = 1000 * 1000;		// us
+constexpr u32 MODE_CROSSFADE_TIME = 150 * 1000;		// us
+
+// Gpio wired to the expander's INT line, set from cmake. The Pico RGB Keypad base doesn't route
+// INT to the pico, so by default there is none and the keys are polled over i2c every sample.
+#ifndef EXPANDER_INTERRUPT_PIN
+	#define EXPANDER_INTERRUPT_PIN -1
+#endif
+
+constexpr i32 EXPANDER_INTERRUPT_PIN_NUMBER = EXPANDER_INTERRUPT_PIN;
+
+static_assert( RGBKeypad::NO_INTERRUPT_PIN == -1, "-1 is no INT line" );
 
 constexpr Colour COLOUR_WHITE = { 31, 31, 31 };
 constexpr Colour COLOUR_RED = { 31, 0, 0 };
@@ -113,6 +142,14 @@ constexpr Colour COLOUR_YELLOW = { 31, 31, 0 };
 constexpr Colour COLOUR_MAGENTA = { 31, 0, 31 };
 constexpr Colour COLOUR_AQUA = { 0, 31, 31 };
 
+constexpr u8 BRIGHTNESS_MODE = RGBKeypad::to_brightness( 0.075f );
+constexpr u8 BRIGHTNESS_MODE_SELECTED = RGBKeypad::to_brightness( 0.25f );
+constexpr u8 BRIGHTNESS_CLEAR_KEY = RGBKeypad::to_brightness( 0.15f );
+constexpr u8 BRIGHTNESS_KEYS = RGBKeypad::to_brightness( 0.2f );
+constexpr u8 BRIGHTNESS_LEVEL_LIGHT = RGBKeypad::to_brightness( 0.75f );
+constexpr u8 BRIGHTNESS_LIGHT = RGBKeypad::to_brightness( 0.65f );
+constexpr u8 BRIGHTNESS_ANIMATION = RGBKeypad::to_brightness( 0.5f );
+
 enum APP_MODE
 {
 	PROGRAMMING_LBOE,
@@ -151,10 +188,94 @@ struct PhotonSmash
 	PHOTON_SMASH_STATE state;
 	u8 level;
 	Colour colour;
-	u32 animationTime;
+	u16 board;										// bit per pad, set is lit
+	u8 brightness;									// of the lit pads
+	Animation animation;
 	bool rainbowLevel;
 };
 
+// Time a core spends doing work, as a percentage of each window
+struct CoreLoad
+{
+	u32 windowStart;
+	u32 busyTime;
+	volatile u32 load;
+
+	void init()
+	{
+		windowStart = time_us_32();
+		busyTime = 0;
+		load = 0;
+	}
+
+	void add( u32 startTime )
+	{
+		busyTime += time_us_32() - startTime;
+	}
+
+	void update()
+	{
+		u32 window = time_us_32() - windowStart;
+
+		if ( window >= CORE_LOAD_WINDOW )
+		{
+			load = static_cast<u32>( ( static_cast<u64>( busyTime ) * 100 ) / window );
+			windowStart += window;
+			busyTime = 0;
+		}
+	}
+};
+
+constexpr Keyframe winKeyframes[] =
+{
+	{ .time = 0, .colour = COLOUR_WHITE, .brightness = BRIGHTNESS_ANIMATION },
+	{ .time = 250 * 1000, .colour = COLOUR_GREEN, .brightness = BRIGHTNESS_ANIMATION },
+	{ .time = 500 * 1000, .colour = COLOUR_WHITE, .brightness = BRIGHTNESS_ANIMATION },
+	{ .time = 750 * 1000, .colour = COLOUR_GREEN, .brightness = BRIGHTNESS_ANIMATION },
+};
+
+constexpr AnimationTrack winAnimation =
+{
+	.keyframes = winKeyframes,
+	.keyframeCount = ARRAY_LENGTH( winKeyframes ),
+	.duration = 1000 * 1000,
+	.interpolate = false,
+	.padOffsets = nullptr,
+};
+
+constexpr Keyframe unsolvableKeyframes[] =
+{
+	{ .time = 0, .colour = COLOUR_YELLOW, .brightness = BRIGHTNESS_ANIMATION },
+	{ .time = 250 * 1000, .colour = COLOUR_RED, .brightness = BRIGHTNESS_ANIMATION },
+	{ .time = 500 * 1000, .colour = COLOUR_YELLOW, .brightness = BRIGHTNESS_ANIMATION },
+	{ .time = 750 * 1000, .colour = COLOUR_RED, .brightness = BRIGHTNESS_ANIMATION },
+	{ .time = 1000 * 1000, .colour = COLOUR_YELLOW, .brightness = BRIGHTNESS_ANIMATION },
+	{ .time = 1250 * 1000, .colour = COLOUR_RED, .brightness = BRIGHTNESS_ANIMATION },
+};
+
+constexpr AnimationTrack unsolvableAnimation =
+{
+	.keyframes = unsolvableKeyframes,
+	.keyframeCount = ARRAY_LENGTH( unsolvableKeyframes ),
+	.duration = 1500 * 1000,
+	.interpolate = false,
+	.padOffsets = nullptr,
+};
+
+// Lights added after the first two of a fallback level, the odds of a 50% -> 25% -> 5% -> 1% chain
+constexpr f64 extraLightWeights[] =
+{
+	0.5,
+	0.5 * 0.75,
+	0.5 * 0.25 * 0.95,
+	0.5 * 0.25 * 0.05 * 0.99,
+	0.5 * 0.25 * 0.05 * 0.01,
+};
+
+constexpr AliasTable<ARRAY_LENGTH( extraLightWeights )> extraLightsTable = make_alias_table( extraLightWeights );
+
+constexpr Chance RAINBOW_LEVEL_CHANCE = chance_percent( 6 );
+
 struct App
 {
 	APP_MODE mode;
@@ -165,57 +286,81 @@ struct App
 	queue_t keyQueue;
 	PhotonSmash photonSmash;
 	bool startResetTimer;
+	bool bootselDown;								// read once per hid tick, see bootsel_read()
+	volatile u32 core1Heartbeat;					// counted up by every pass of core1's loop
+	u32 lastCore1Heartbeat;							// core1 has moved on since this, feed the watchdog
 	u32 rainbowColourTimer;
 	u8 rainbowColourUpdateRate;
 	Colour rainbowHSVColour;
+	SpscRing<RGBKeypad::Frame, MAX_LED_FRAMES> ledFrames;	// core0 -> core1
+	CoreLoad core0Load;
+	CoreLoad core1Load;
+	Crossfade crossfade;						// the background, from what was showing to the new mode
+	Compositor compositor;
 };
 
 App app;
 RGBKeypad rgbKeypad;
+KeypadInput keypadInput;
 
-static void toggle_light( u8 index )
+#ifdef DEBUG
+	// Cycle counts measured at startup, read them with a debugger
+	struct DebugBenchmarks
+	{
+		u32 brightnessFloat;					// set_colour + get_brightness, per pad
+		u32 brightnessRaw;						// set_colour_raw + get_brightness_raw, per pad
+		u32 irandomFloat;						// old float scaled irandom( 99 ), per call
+		u32 irandomInt;							// irandom( 99 ), per call
+		u32 xoshiro256starstar;					// engine next32(), per number
+		u32 xoshiro256plus;
+		u32 xoshiro128starstar;
+		u32 xoshiro128plus;
+		u32 pcg32;
+		u32 subsetLoop;							// 8 of 16 pads by the old positions loop
+		u32 subsetBitmask;						// 8 of 16 pads by random_subset
+		u32 normal[ 5 ];						// normal_q16(), per number, engines in the order above
+		u32 exponential;						// random_exponential_q16(), per number
+		u32 hsvToRgbFloat;						// per conversion
+		u32 hsvToRgbInt;
+		u32 rgbToHsvFloat;
+		u32 rgbToHsvInt;
+		u32 lerpFrameBytes;						// every pad a -> b a channel at a time, per frame
+		u32 lerpFramePacked;					// colour_span_lerp_q8(), per frame
+		u32 addSaturateFrame;					// colour_span_add_saturate(), per frame
+		u32 scaleFrame;							// colour_span_scale_q8(), per frame
+		u32 packedMismatches;					// lerps that differ between the two, should be 0
+		u32 composeAll;							// flush with every layer changed
+		u32 composeOverlay;						// flush with only a half alpha overlay changed
+		u32 composeSkipped;						// flush with nothing changed
+	};
+
+	DebugBenchmarks debugBenchmarks;
+	volatile u32 debugBenchmarkSink;
+#endif
+
+// BOOTSEL is read by floating the flash chip select, which is only safe while nothing fetches
+// from flash. Core1 runs from flash, so hold it in its lockout handler (in ram) for the read.
+static bool bootsel_read()
 {
-	rgbKeypad.set_colour( index, app.photonSmash.colour, rgbKeypad.get_brightness( index ) == 0 ? 0.65f : 0 );
-}
+	multicore_lockout_start_blocking();
 
-static bool photon_smash_solvability_check( u8 lights[ RGBKeypad::NUM_PADS ] )
-{
-	// Attempt to solve the state
-	for ( i32 index = 4; index < RGBKeypad::NUM_PADS; ++index )
-	{
-		if ( lights[ index - 4 ] )
-		{
-			lights[ index ] = !lights[ index ];
-			lights[ index - 4 ] = !lights[ index - 4 ];
+	bool down = board_button_read();
 
-			// Check its not at the bottom edge
-			if ( index < 12 )
-			{
-				lights[ index + 4 ] = !lights[ index + 4 ];
-			}
+	multicore_lockout_end_blocking();
 
-			// Check its not at the left edge
-			if ( index % 4 != 0 )
-			{
-				lights[ index - 1 ] = !lights[ index - 1 ];
-			}
+	return down;
+}
 
-			// Check its not at the right edge
-			if ( ( index + 1 ) % 4 != 0 )
-			{
-				lights[ index + 1 ] = !lights[ index + 1 ];
-			}
-		}
-	}
+// Only fed while core1 is still going round its loop, so a hang on either core resets
+static void watchdog_feed()
+{
+	u32 heartbeat = app.core1Heartbeat;
 
-	// If any lights are still on it failed
-	for ( i32 index = 0; index < RGBKeypad::NUM_PADS; ++index )
+	if ( heartbeat != app.lastCore1Heartbeat )
 	{
-		if ( lights[ index ] )
-			return false;
+		app.lastCore1Heartbeat = heartbeat;
+		watchdog_update();
 	}
-
-	return true;
 }
 
 static void system_reset()
@@ -224,39 +369,71 @@ static void system_reset()
 	while ( 1 );
 }
 
-static bool photon_smash_solvability_check()
+// The content layer drawn from the board, unlit pads are off
+static void photon_smash_render()
 {
-	u8 lights[ RGBKeypad::NUM_PADS ];
+	Layer *lights = app.compositor.layer( LAYER::CONTENT );
 
-	// Copy the state
-	for ( i32 index = 0; index < RGBKeypad::NUM_PADS; ++index )
+	PackedColour lit = pack_colour( app.photonSmash.colour, app.photonSmash.brightness );
+	PackedColour unlit = pack_colour( app.photonSmash.colour, 0 );
+
+	for ( i32 i = 0; i < RGBKeypad::NUM_PADS; ++i )
 	{
-		lights[ index ] = rgbKeypad.get_brightness( index ) != 0;
+		lights->set_pad( i, ( app.photonSmash.board >> i ) & 1 ? lit : unlit );
 	}
-
-	return photon_smash_solvability_check( lights );
 }
 
 static void default_selections()
 {
 	for ( i32 i = 0; i < APP_MODE::COUNT; ++i )
 	{
-		rgbKeypad.set_colour( i, colourThemes[ i ], 0.075f );
+		app.compositor.layer( LAYER::BACKGROUND )->set_colour_raw( i, colourThemes[ i ], BRIGHTNESS_MODE );
+	}
+
+	app.compositor.layer( LAYER::BACKGROUND )->set_colour_raw( app.mode, colourThemes[ app.mode ], BRIGHTNESS_MODE_SELECTED );
+
+	app.compositor.layer( LAYER::BACKGROUND )->set_colour_raw( 7, COLOUR_RED, BRIGHTNESS_CLEAR_KEY );
+}
+
+// The mode selection row, the red clear key and the mode's own keys
+static constexpr RGBKeypad::Frame make_mode_frame( APP_MODE mode )
+{
+	RGBKeypad::Frame frame = RGBKeypad::clear_frame();
+
+	for ( i32 i = 0; i < APP_MODE::COUNT; ++i )
+	{
+		frame.set( i, colourThemes[ i ], BRIGHTNESS_MODE );
 	}
 
-	rgbKeypad.set_colour( app.mode, colourThemes[ app.mode ], 0.25f );
+	frame.set( mode, colourThemes[ mode ], BRIGHTNESS_MODE_SELECTED );
+
+	frame.set( 7, COLOUR_RED, BRIGHTNESS_CLEAR_KEY );
 
-	rgbKeypad.set_colour( 7, COLOUR_RED, 0.15f );
+	for ( i32 i = 8; i < 16; ++i )
+	{
+		frame.set( i, colourThemes[ mode ], BRIGHTNESS_KEYS );
+	}
+
+	return frame;
 }
 
+// Built at compile time so switching to one of these modes is a copy from flash
+constexpr RGBKeypad::Frame modeFrames[] =
+{
+	make_mode_frame( APP_MODE::PROGRAMMING_LBOE ),
+	make_mode_frame( APP_MODE::PROGRAMMING_GBC ),
+	make_mode_frame( APP_MODE::PROGRAMMING_PICO_PROJECT ),
+	make_mode_frame( APP_MODE::KEYBINDS ),
+};
+
+static_assert( ARRAY_LENGTH( modeFrames ) == APP_MODE::KEYBINDS + 1 );
+
 static void app_switch_mode( APP_MODE newMode )
 {
 	APP_MODE prevAppMode = app.mode;
 
 	app.mode = newMode;
 
-	rgbKeypad.clear();
-
 	switch ( newMode )
 	{
 	case APP_MODE::PROGRAMMING_LBOE:
@@ -266,16 +443,19 @@ static void app_switch_mode( APP_MODE newMode )
 	case APP_MODE::PROGRAMMING_PICO_PROJECT:
 		[[fallthrough]];
 	case APP_MODE::KEYBINDS:
-		default_selections();
+		app.compositor.layer( LAYER::CONTENT )->clear();
+		app.compositor.layer( LAYER::OVERLAY )->clear();
 
-		for ( i32 i = 8; i < 16; ++i )
-		{
-			rgbKeypad.set_colour( i, colourThemes[ newMode ], 0.2f );
-		}
+		app.crossfade.start( rgbKeypad.ledData, modeFrames[ newMode ], MODE_CROSSFADE_TIME, time_us_32() );
 		break;
 
 	case APP_MODE::GAME_PHOTON_SMASH:
 		{
+			app.crossfade.stop();
+			app.photonSmash.animation.stop();
+
+			app.compositor.clear();
+
 			if ( prevAppMode != GAME_PHOTON_SMASH )
 			{
 				app.photonSmash.prevMode = prevAppMode;
@@ -283,131 +463,96 @@ static void app_switch_mode( APP_MODE newMode )
 
 			app.photonSmash.state = PHOTON_SMASH_STATE::GAME;
 
-			app.photonSmash.colour =
+			// The level stream is only used here, so the levels come out the same for a seed whatever
+			// else used random numbers. The colour doesn't matter, it comes from core1's pool.
+			RandomStream *random = random_stream( RANDOM_STREAM::PHOTON_SMASH );
+			PooledRandom *pool = random_pool();
+			PhotonSmash *game = &app.photonSmash;
+
+			game->colour =
 			{
-				static_cast<u8>( irandom( static_cast<u32>( 31 ) ) ),
-				static_cast<u8>( irandom( static_cast<u32>( 31 ) ) ),
-				static_cast<u8>( irandom( static_cast<i32>( 31 ) ) )
+				static_cast<u8>( pool->irandom( static_cast<u32>( 31 ) ) ),
+				static_cast<u8>( pool->irandom( static_cast<u32>( 31 ) ) ),
+				static_cast<u8>( pool->irandom( static_cast<i32>( 31 ) ) )
 			};
 
-			i32 lvl = app.photonSmash.level;
+			i32 lvl = game->level;
 
 			if ( lvl < ARRAY_LENGTH( photonSmashPredefinedLevels ) )
 			{
-				const PhotonSmashPredefinedLevel *predefinedLevel = &photonSmashPredefinedLevels[ lvl ];
-
-				for ( i32 i = 0, count = predefinedLevel->lightsCount; i < count; ++i )
-				{
-					rgbKeypad.set_colour( predefinedLevel->lights[ i ], app.photonSmash.colour, 0.75f );
-				}
+				game->board = photon_smash_level_board( photonSmashPredefinedLevels[ lvl ] );
+				game->brightness = BRIGHTNESS_LEVEL_LIGHT;
 
 				// Check the predefined level can be completed, if not flash red
-				if ( !photon_smash_solvability_check() )
+				if ( !photon_smash_solvable( game->board ) )
 				{
-					app.photonSmash.state = PHOTON_SMASH_STATE::UNSOLVABLE_ANIMATION;
-					app.photonSmash.animationTime = 0;
+					game->state = PHOTON_SMASH_STATE::UNSOLVABLE_ANIMATION;
+					game->animation.play( &unsolvableAnimation, time_us_32() );
 				}
 			}
 			else
 			{
-				i32 startWithLigjts = min( static_cast<i32>( 15 ), irandom_range( 1 + lvl / 10, lvl / 3 ) );
-				u8 positions[ RGBKeypad::NUM_PADS ] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
-				i32 positionsCount = 15;
+				i32 startWithLights = min( static_cast<i32>( 15 ), random->irandom_range( 1 + lvl / 10, lvl / 3 ) );
 
-				while ( startWithLigjts-- > 0 )
-				{
-					i32 r = irandom_range( 0, positionsCount );
-					rgbKeypad.set_colour( positions[ r ], app.photonSmash.colour, 0.65f );
-					positions[ r ] = positions[ positionsCount-- ];
-				}
+				// Bit per distinct pad to light
+				game->board = static_cast<u16>( random->random_subset( RGBKeypad::NUM_PADS, max( startWithLights, static_cast<i32>( 0 ) ) ) );
+				game->brightness = BRIGHTNESS_LIGHT;
 
 				// Check if can be solved, if not, generate one in a safer method
-				if ( !photon_smash_solvability_check() )
+				if ( !photon_smash_solvable( game->board ) )
 				{
-					rgbKeypad.clear();
+					game->board = 0;
 
-					i32 presses = min( static_cast<i32>( 50 ), irandom_range( 1 + lvl, lvl * 2 ) );
+					i32 presses = min( static_cast<i32>( 50 ), random->irandom_range( 1 + lvl, lvl * 2 ) );
 
 					while ( presses-- > 0 )
 					{
-						toggle_light( static_cast<u8>( irandom( RGBKeypad::NUM_PADS ) ) );
-					}
-
-					bool oneLit = false;
-					for ( i32 i = 0; i < RGBKeypad::NUM_PADS; ++i )
-					{
-						if ( rgbKeypad.get_brightness( i ) != 0 )
-						{
-							oneLit = true;
-							break;
-						}
+						game->board ^= 1 << random->irandom( RGBKeypad::NUM_PADS - 1 );
 					}
 
 					// If one wasn't lit or its not solvable, generate another
-					if ( !oneLit || !photon_smash_solvability_check() )
+					if ( game->board == 0 || !photon_smash_solvable( game->board ) )
 					{
-						rgbKeypad.clear();
-
-						i32 position = irandom( RGBKeypad::NUM_PADS - 1 );
-						toggle_light( position );
+						i32 position = random->irandom( RGBKeypad::NUM_PADS - 1 );
+						game->board = static_cast<u16>( 1 << position );
 
-						position = ( position + irandom( RGBKeypad::NUM_PADS - 2 ) ) % RGBKeypad::NUM_PADS;
-						toggle_light( position );
+						position = ( position + random->irandom( RGBKeypad::NUM_PADS - 2 ) ) % RGBKeypad::NUM_PADS;
+						game->board ^= 1 << position;
 
-						if ( proc( 50 ) )
+						for ( u32 extra = random->choose( extraLightsTable ); extra > 0; --extra )
 						{
-							position = ( position + irandom( RGBKeypad::NUM_PADS - 2 ) ) % RGBKeypad::NUM_PADS;
-							toggle_light( position );
-
-							if ( proc( 25 ) )
-							{
-								position = ( position + irandom( RGBKeypad::NUM_PADS - 2 ) ) % RGBKeypad::NUM_PADS;
-								toggle_light( position );
-
-								if ( proc( 5 ) )
-								{
-									position = ( position + irandom( RGBKeypad::NUM_PADS - 2 ) ) % RGBKeypad::NUM_PADS;
-									toggle_light( position );
-
-									if ( proc( 1 ) )
-									{
-										position = ( position + irandom( RGBKeypad::NUM_PADS - 2 ) ) % RGBKeypad::NUM_PADS;
-										toggle_light( position );
-									}
-								}
-							}
+							position = ( position + random->irandom( RGBKeypad::NUM_PADS - 2 ) ) % RGBKeypad::NUM_PADS;
+							game->board ^= 1 << position;
 						}
 					}
 
 					// Check if it can be completed, if not, use a random predefined level
-					if ( !photon_smash_solvability_check() )
+					if ( !photon_smash_solvable( game->board ) )
 					{
-						rgbKeypad.clear();
+						i32 randomPredefinedLevel = random->irandom( ARRAY_LENGTH( photonSmashPredefinedLevels ) - 1 );
 
-						i32 randomPredefinedLevel = irandom( static_cast<i32>( ARRAY_LENGTH( photonSmashPredefinedLevels ) - 1 ) );
-
-						const PhotonSmashPredefinedLevel *predefinedLevel = &photonSmashPredefinedLevels[ randomPredefinedLevel ];
-
-						for ( i32 i = 0, count = predefinedLevel->lightsCount; i < count; ++i )
-						{
-							rgbKeypad.set_colour( predefinedLevel->lights[ i ], app.photonSmash.colour, 0.75f );
-						}
+						game->board = photon_smash_level_board( photonSmashPredefinedLevels[ randomPredefinedLevel ] );
+						game->brightness = BRIGHTNESS_LEVEL_LIGHT;
 					}
 
 					// Check it can be completed again, if not flash red
-					if ( !photon_smash_solvability_check() )
+					if ( !photon_smash_solvable( game->board ) )
 					{
-						app.photonSmash.state = PHOTON_SMASH_STATE::UNSOLVABLE_ANIMATION;
-						app.photonSmash.animationTime = 0;
+						game->state = PHOTON_SMASH_STATE::UNSOLVABLE_ANIMATION;
+						game->animation.play( &unsolvableAnimation, time_us_32() );
 					}
 				}
 			}
 
-			app.photonSmash.rainbowLevel = proc( 6 );
+			photon_smash_render();
+
+			app.photonSmash.rainbowLevel = random->proc( RAINBOW_LEVEL_CHANCE );
 		}
 		break;
 
 	default:
+		app.crossfade.stop();
+		app.compositor.clear();
 		default_selections();
 		break;
 	}
@@ -570,32 +715,514 @@ static void mode_selection( u16 keysPressed, u16 keysDown )
 	}
 	else if ( keysPressed & KEY_7 )
 	{
-		rgbKeypad.clear();
+		app.crossfade.stop();
+		app.compositor.clear();
 	}
 }
 
-int main()
+// Every pressed key, lowest first, stops at a win
+static void photon_smash_keys_pressed( u16 keysPressed )
+{
+	PhotonSmash *game = &app.photonSmash;
+
+	for ( ; keysPressed; keysPressed &= keysPressed - 1 )
+	{
+		game->board ^= photonSmashPressMasks.masks[ __builtin_ctz( keysPressed ) ];
+
+		if ( game->board == 0 )
+		{
+			game->state = PHOTON_SMASH_STATE::WIN_ANIMATION;
+			game->level += 1;
+			game->animation.play( &winAnimation, time_us_32() );
+			break;
+		}
+	}
+
+	photon_smash_render();
+}
+
+// Invoked for every debounced key press, in the order they happened
+static void app_key_pressed( u8 key, u16 keysDown )
+{
+	u16 keysPressed = 1 << key;
+
+	switch ( app.mode )
+	{
+	case APP_MODE::PROGRAMMING_LBOE:
+		{
+			mode_selection( keysPressed, keysDown );
+			key_check( KEYBOARD_MODIFIER_LEFTALT | KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT, keysPressed, keysDown );
+		}
+		break;
+
+	case APP_MODE::PROGRAMMING_GBC:
+		{
+			mode_selection( keysPressed, keysDown );
+			key_check( KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT, keysPressed, keysDown );
+		}
+		break;
+
+	case APP_MODE::PROGRAMMING_PICO_PROJECT:
+		{
+			mode_selection( keysPressed, keysDown );
+			key_check( KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_RIGHTCTRL | KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT, keysPressed, keysDown );
+		}
+		break;
+
+	case APP_MODE::KEYBINDS:
+		{
+			mode_selection( keysPressed, keysDown );
+			key_check( KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT, keysPressed, keysDown );
+		}
+		break;
+
+	case APP_MODE::GAME_PHOTON_SMASH:
+		if ( app.photonSmash.state == PHOTON_SMASH_STATE::GAME )
+		{
+			photon_smash_keys_pressed( keysPressed );
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+// Invoked every update tick
+static void app_update()
+{
+	u32 time = time_us_32();
+
+	app.crossfade.update( app.compositor.layer( LAYER::BACKGROUND ), time );
+
+	switch ( app.mode )
+	{
+	case APP_MODE::GAME_PHOTON_SMASH:
+		if ( app.bootselDown )
+		{
+			// Exit game
+			app_switch_mode( app.photonSmash.prevMode );
+		}
+		else
+		{
+			switch ( app.photonSmash.state )
+			{
+			case PHOTON_SMASH_STATE::GAME:
+				if ( app.photonSmash.rainbowLevel )
+				{
+					app.photonSmash.colour = hsv_to_rgb( app.rainbowHSVColour );
+					photon_smash_render();
+				}
+				break;
+
+			case PHOTON_SMASH_STATE::WIN_ANIMATION:
+				if ( !app.photonSmash.animation.update( app.compositor.layer( LAYER::OVERLAY ), time ) )
+				{
+					app_switch_mode( APP_MODE::GAME_PHOTON_SMASH );
+				}
+				break;
+
+			case PHOTON_SMASH_STATE::UNSOLVABLE_ANIMATION:
+				if ( !app.photonSmash.animation.update( app.compositor.layer( LAYER::OVERLAY ), time ) )
+				{
+					app_switch_mode( app.photonSmash.prevMode );
+				}
+				break;
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+#ifdef DEBUG
+template <typename Engine>
+static u32 debug_engine_cycles()
+{
+	constexpr i32 NUMBERS = 1000;
+
+	Random<Engine> random;
+	random.set_seed( 0x5EED );
+
+	u32 sum = 0;
+	u32 start = cycles_now();
+
+	for ( i32 i = 0; i < NUMBERS; ++i )
+	{
+		sum += random.engine.next32();
+	}
+
+	u32 cycles = cycles_since( start ) / NUMBERS;
+
+	debugBenchmarkSink = sum;
+
+	return cycles;
+}
+
+template <typename Engine>
+static u32 debug_normal_cycles()
+{
+	constexpr i32 NUMBERS = 1000;
+
+	Random<Engine> random;
+	random.set_seed( 0x5EED );
+
+	i32 sum = 0;
+	u32 start = cycles_now();
+
+	for ( i32 i = 0; i < NUMBERS; ++i )
+	{
+		sum += random.normal_q16();
+	}
+
+	u32 cycles = cycles_since( start ) / NUMBERS;
+
+	debugBenchmarkSink = sum;
+
+	return cycles;
+}
+
+static void debug_benchmarks()
+{
+	cycles_init();
+
+	u32 start = cycles_now();
+	u32 lit = 0;
+
+	for ( u8 i = 0; i < RGBKeypad::NUM_PADS; ++i )
+	{
+		rgbKeypad.set_colour( i, COLOUR_WHITE, 0.65f );
+		lit += rgbKeypad.get_brightness( i ) != 0;
+	}
+
+	debugBenchmarks.brightnessFloat = cycles_since( start ) / RGBKeypad::NUM_PADS;
+
+	rgbKeypad.clear();
+
+	start = cycles_now();
+
+	for ( u8 i = 0; i < RGBKeypad::NUM_PADS; ++i )
+	{
+		rgbKeypad.set_colour_raw( i, COLOUR_WHITE, BRIGHTNESS_LIGHT );
+		lit += rgbKeypad.get_brightness_raw( i ) != 0;
+	}
+
+	debugBenchmarks.brightnessRaw = cycles_since( start ) / RGBKeypad::NUM_PADS;
+
+	debugBenchmarkSink = lit;
+
+	rgbKeypad.clear();
+
+	constexpr i32 RANDOM_SAMPLES = 6000;
+	u32 sum = 0;
+
+	start = cycles_now();
+
+	for ( i32 i = 0; i < RANDOM_SAMPLES; ++i )
+	{
+		sum += static_cast<u32>( random_f32_0_1() * 100 );
+	}
+
+	debugBenchmarks.irandomFloat = cycles_since( start ) / RANDOM_SAMPLES;
+
+	start = cycles_now();
+
+	for ( i32 i = 0; i < RANDOM_SAMPLES; ++i )
+	{
+		sum += irandom( static_cast<u32>( 99 ) );
+	}
+
+	debugBenchmarks.irandomInt = cycles_since( start ) / RANDOM_SAMPLES;
+
+	debugBenchmarkSink = sum;
+
+	debugBenchmarks.xoshiro256starstar = debug_engine_cycles<Xoshiro256starstar>();
+	debugBenchmarks.xoshiro256plus = debug_engine_cycles<Xoshiro256plus>();
+	debugBenchmarks.xoshiro128starstar = debug_engine_cycles<Xoshiro128starstar>();
+	debugBenchmarks.xoshiro128plus = debug_engine_cycles<Xoshiro128plus>();
+	debugBenchmarks.pcg32 = debug_engine_cycles<Pcg32>();
+
+	constexpr i32 SUBSETS = 100;
+	u64 subsets = 0;
+
+	start = cycles_now();
+
+	for ( i32 i = 0; i < SUBSETS; ++i )
+	{
+		u8 positions[ RGBKeypad::NUM_PADS ] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+		i32 positionsCount = 15;
+
+		for ( i32 picks = 8; picks > 0; --picks )
+		{
+			i32 r = irandom_range( 0, positionsCount );
+			subsets |= UINT64_C( 1 ) << positions[ r ];
+			positions[ r ] = positions[ positionsCount-- ];
+		}
+	}
+
+	debugBenchmarks.subsetLoop = cycles_since( start ) / SUBSETS;
+
+	start = cycles_now();
+
+	for ( i32 i = 0; i < SUBSETS; ++i )
+	{
+		subsets |= random_subset( RGBKeypad::NUM_PADS, 8 );
+	}
+
+	debugBenchmarks.subsetBitmask = cycles_since( start ) / SUBSETS;
+
+	debugBenchmarkSink = static_cast<u32>( subsets );
+
+	debugBenchmarks.normal[ 0 ] = debug_normal_cycles<Xoshiro256starstar>();
+	debugBenchmarks.normal[ 1 ] = debug_normal_cycles<Xoshiro256plus>();
+	debugBenchmarks.normal[ 2 ] = debug_normal_cycles<Xoshiro128starstar>();
+	debugBenchmarks.normal[ 3 ] = debug_normal_cycles<Xoshiro128plus>();
+	debugBenchmarks.normal[ 4 ] = debug_normal_cycles<Pcg32>();
+
+	constexpr i32 VARIATES = 4096;
+	i64 exponentialSum = 0;
+
+	start = cycles_now();
+
+	for ( i32 i = 0; i < VARIATES; ++i )
+	{
+		exponentialSum += random_exponential_q16();
+	}
+
+	debugBenchmarks.exponential = cycles_since( start ) / VARIATES;
+
+	debugBenchmarkSink = static_cast<u32>( exponentialSum );
+
+	// Around the rainbow wheel
+	constexpr i32 HUES = 32;
+	u32 colours = 0;
+
+	start = cycles_now();
+
+	for ( i32 h = 0; h < HUES; ++h )
+	{
+		Colour colour = hsv_to_rgb_reference( { static_cast<u8>( h ), 31, 31 } );
+		colours += colour.r + colour.g + colour.b;
+	}
+
+	debugBenchmarks.hsvToRgbFloat = cycles_since( start ) / HUES;
+
+	start = cycles_now();
+
+	for ( i32 h = 0; h < HUES; ++h )
+	{
+		Colour colour = hsv_to_rgb( { static_cast<u8>( h ), 31, 31 } );
+		colours += colour.r + colour.g + colour.b;
+	}
+
+	debugBenchmarks.hsvToRgbInt = cycles_since( start ) / HUES;
+
+	start = cycles_now();
+
+	for ( i32 h = 0; h < HUES; ++h )
+	{
+		Colour colour = rgb_to_hsv_reference( { static_cast<u8>( h ), static_cast<u8>( 31 - h ), 7 } );
+		colours += colour.r + colour.g + colour.b;
+	}
+
+	debugBenchmarks.rgbToHsvFloat = cycles_since( start ) / HUES;
+
+	start = cycles_now();
+
+	for ( i32 h = 0; h < HUES; ++h )
+	{
+		Colour colour = rgb_to_hsv( { static_cast<u8>( h ), static_cast<u8>( 31 - h ), 7 } );
+		colours += colour.r + colour.g + colour.b;
+	}
+
+	debugBenchmarks.rgbToHsvInt = cycles_since( start ) / HUES;
+
+	debugBenchmarkSink = colours;
+
+	constexpr i32 FRAMES = 64;
+
+	alignas( 4 ) u8 frameA[ RGBKeypad::FRAME_SIZE ];
+	alignas( 4 ) u8 frameB[ RGBKeypad::FRAME_SIZE ];
+	alignas( 4 ) u8 frameBytes[ RGBKeypad::FRAME_SIZE ];
+	PackedColour packedA[ RGBKeypad::NUM_PADS ];
+	PackedColour packedB[ RGBKeypad::NUM_PADS ];
+	PackedColour packedFrame[ RGBKeypad::NUM_PADS ];
+
+	for ( i32 i = 0; i < RGBKeypad::NUM_PADS; ++i )
+	{
+		packedA[ i ] = pack_colour( colourThemes[ i % APP_MODE::COUNT ], static_cast<u8>( i * 2 ) );
+		packedB[ i ] = pack_colour( hsv_to_rgb( { static_cast<u8>( i * 2 ), 31, 31 } ), RGBKeypad::MAX_BRIGHTNESS - i );
+	}
+
+	memcpy( frameA, packedA, RGBKeypad::FRAME_SIZE );
+	memcpy( frameB, packedB, RGBKeypad::FRAME_SIZE );
+
+	u32 mismatches = 0;
+
+	start = cycles_now();
+
+	for ( i32 frame = 0; frame < FRAMES; ++frame )
+	{
+		u32 fraction = frame * 4;
+
+		for ( i32 i = 0; i < RGBKeypad::FRAME_SIZE; ++i )
+		{
+			u32 a = frameA[ i ] & ( i % 4 == 0 ? 0b00011111 : 0xFF );
+			u32 b = frameB[ i ] & ( i % 4 == 0 ? 0b00011111 : 0xFF );
+			u32 value = ( a * ( 256 - fraction ) + b * fraction ) >> 8;
+
+			frameBytes[ i ] = static_cast<u8>( i % 4 == 0 ? 0b11100000 | value : value );
+		}
+	}
+
+	debugBenchmarks.lerpFrameBytes = cycles_since( start ) / FRAMES;
+
+	start = cycles_now();
+
+	for ( i32 frame = 0; frame < FRAMES; ++frame )
+		colour_span_lerp_q8( packedFrame, packedA, packedB, frame * 4, RGBKeypad::NUM_PADS );
+
+	debugBenchmarks.lerpFramePacked = cycles_since( start ) / FRAMES;
+
+	// Both ended on the last fraction
+	for ( i32 i = 0; i < RGBKeypad::NUM_PADS; ++i )
+		mismatches += load_packed( &frameBytes[ i * 4 ] ) != packedFrame[ i ];
+
+	debugBenchmarks.packedMismatches = mismatches;
+
+	start = cycles_now();
+
+	for ( i32 frame = 0; frame < FRAMES; ++frame )
+		colour_span_add_saturate( packedFrame, packedFrame, packedB, RGBKeypad::NUM_PADS );
+
+	debugBenchmarks.addSaturateFrame = cycles_since( start ) / FRAMES;
+
+	start = cycles_now();
+
+	for ( i32 frame = 0; frame < FRAMES; ++frame )
+		colour_span_scale_q8( packedFrame, packedFrame, 250, RGBKeypad::NUM_PADS );
+
+	debugBenchmarks.scaleFrame = cycles_since( start ) / FRAMES;
+
+	debugBenchmarkSink = packedFrame[ 0 ];
+
+	Compositor compositor;
+	compositor.init();
+
+	Layer *background = compositor.layer( LAYER::BACKGROUND );
+	Layer *content = compositor.layer( LAYER::CONTENT );
+	Layer *overlay = compositor.layer( LAYER::OVERLAY );
+
+	overlay->set_alpha( Layer::OPAQUE / 2 );
+
+	start = cycles_now();
+
+	for ( i32 frame = 0; frame < FRAMES; ++frame )
+	{
+		background->set_frame( modeFrames[ frame % ARRAY_LENGTH( modeFrames ) ] );
+		content->set_colour_raw( frame % RGBKeypad::NUM_PADS, COLOUR_MAGENTA, BRIGHTNESS_LIGHT );
+		overlay->set_colour_raw( ( frame * 7 ) % RGBKeypad::NUM_PADS, COLOUR_WHITE, BRIGHTNESS_ANIMATION );
+		compositor.flush( &rgbKeypad );
+	}
+
+	debugBenchmarks.composeAll = cycles_since( start ) / FRAMES;
+
+	start = cycles_now();
+
+	for ( i32 frame = 0; frame < FRAMES; ++frame )
+	{
+		overlay->set_colour_raw( ( frame * 7 ) % RGBKeypad::NUM_PADS, frame & 1 ? COLOUR_WHITE : COLOUR_AQUA, BRIGHTNESS_ANIMATION );
+		compositor.flush( &rgbKeypad );
+	}
+
+	debugBenchmarks.composeOverlay = cycles_since( start ) / FRAMES;
+
+	start = cycles_now();
+
+	for ( i32 frame = 0; frame < FRAMES; ++frame )
+		compositor.flush( &rgbKeypad );
+
+	debugBenchmarks.composeSkipped = cycles_since( start ) / FRAMES;
+
+	rgbKeypad.clear();
+}
+#endif
+
+// Core1 owns the keypad, it scans the keys and sends the frames core0 builds
+static void core1_main()
 {
+	rgbKeypad.init( RGBKeypad::DEFAULT_BRIGHTNESS, RGBKeypad::I2C_FAST_MODE, EXPANDER_INTERRUPT_PIN_NUMBER );
+	keypadInput.init( &rgbKeypad );
+
+	app.core1Load.init();
+
+	// Lets core0 pause this core while it reads BOOTSEL
+	multicore_lockout_victim_init();
+
+	multicore_fifo_push_blocking( CORE1_READY );
+
+	while ( true )
 	{
-		u64 seed[ 9 ] =
+		u32 startTime = time_us_32();
+		bool worked = keypadInput.update();
+
+		app.core1Heartbeat += 1;
+
+		if ( !rgbKeypad.is_busy() )
+		{
+			RGBKeypad::Frame frame;
+
+			if ( app.ledFrames.pop( &frame ) )
+			{
+				rgbKeypad.send_frame_async( frame.data );
+				worked = true;
+			}
+			else if ( rgbKeypad.refresh_async() )
+			{
+				worked = true;
+			}
+		}
+
+		if ( worked )
+		{
+			app.core1Load.add( startTime );
+		}
+		else
 		{
-			get_rand_64(),
-			get_rand_64(),
-			get_rand_64(),
-			get_rand_64(),
-			get_rand_64(),
-			get_rand_64(),
-			get_rand_64(),
-			get_rand_64(),
-			get_rand_64(),
-		};
+			// Spare time, make random numbers ahead for core0
+			random_pool_refill( RandomPool::REFILL_BLOCK );
+		}
+
+		app.core1Load.update();
+	}
+}
+
+int main()
+{
+	{
+		u64 seed[ RANDOM_SEED_WORDS ];
+
+		for ( u64 &word : seed )
+			word = get_rand_64();
 
 		random_set_seed( seed );
 	}
 
 	board_init();
 	tusb_init();
-	rgbKeypad.init();
+
+	app.ledFrames.init();
+	app.compositor.init();
+	app.core0Load.init();
+
+	multicore_launch_core1( core1_main );
+
+	// Wait for the keypad to be setup before building frames for it
+	while ( multicore_fifo_pop_blocking() != CORE1_READY )
+		tight_loop_contents();
+
 	gpio_init( PICO_DEFAULT_LED_PIN );
 
 	gpio_set_dir( PICO_DEFAULT_LED_PIN, GPIO_OUT );
@@ -607,39 +1234,38 @@ int main()
 	app.updateRate = app.updateTimer;
 	app.photonSmash.level = 0;
 	app.startResetTimer = false;
+	app.bootselDown = false;
+	app.lastCore1Heartbeat = app.core1Heartbeat;
 	app.rainbowColourTimer = 0;
 	app.rainbowColourUpdateRate = 1;				// updates before changing colour
 	app.rainbowHSVColour = { 0, 31, 31 };
 
 	queue_init( &app.keyQueue, sizeof( QueuedKey ), MAX_KEY_QUEUE_ELEMENTS );
 
+	#ifdef DEBUG
+		debug_benchmarks();
+	#endif
+
 	app_switch_mode( APP_MODE::PROGRAMMING_GBC );
 
 	// In debug mode check all the predefined levels can be solved
 	#ifdef DEBUG
 		for ( i32 i = 0; i < ARRAY_LENGTH( photonSmashPredefinedLevels ); ++i )
 		{
-			u8 lights[ RGBKeypad::NUM_PADS ] = {};
-
-			const PhotonSmashPredefinedLevel *predefinedLevel = &photonSmashPredefinedLevels[ i ];
-
-			for ( i32 lightIdx = 0, count = predefinedLevel->lightsCount; lightIdx < count; ++lightIdx )
-			{
-				lights[ predefinedLevel->lights[ lightIdx ] ] = 1;
-			}
-
 			// Check the predefined level can be completed
-			if ( !photon_smash_solvability_check( lights ) )
+			if ( !photon_smash_solvable( photon_smash_level_board( photonSmashPredefinedLevels[ i ] ) ) )
 			{
-				rgbKeypad.clear();
+				Layer *overlay = app.compositor.layer( LAYER::OVERLAY );
+
+				overlay->clear();
 
-				rgbKeypad.set_colour( i, COLOUR_YELLOW, 1.0f );
+				overlay->set_colour_raw( i, COLOUR_YELLOW, RGBKeypad::MAX_BRIGHTNESS );
 
 				i -= 16;
 
 				if ( i > 0 )
 				{
-					rgbKeypad.set_colour( i / 16, COLOUR_RED, 1.0f );
+					overlay->set_colour_raw( i / 16, COLOUR_RED, RGBKeypad::MAX_BRIGHTNESS );
 				}
 
 				break;
@@ -647,7 +1273,6 @@ int main()
 		}
 	#endif
 
-	u16 keysDownLast = 0;
 	u32 time = board_millis();
 	u32 lastTime = time;
 	u32 timeDiff = 0;
@@ -656,6 +1281,9 @@ int main()
 
 	while ( true )
 	{
+		u32 startTime = time_us_32();
+		bool worked = tud_task_event_ready();
+
 		tud_task();
 
 		lastTime = time;
@@ -665,14 +1293,28 @@ int main()
 		app.hidTaskTimer += timeDiff;
 		app.updateTimer += timeDiff;
 
+		// Sampled every 1ms on core1, handle every press as soon as it is debounced
+		KeyEvent keyEvent;
+
+		while ( keypadInput.pop( &keyEvent ) )
+		{
+			if ( keyEvent.pressed )
+			{
+				app_key_pressed( keyEvent.key, keyEvent.keysDown );
+			}
+
+			worked = true;
+		}
+
 		// Update every 8ms
 		if ( app.hidTaskTimer >= app.hidTaskRate )
 		{
 			app.hidTaskTimer -= app.hidTaskRate;
+			worked = true;
 
-			u32 const btn = board_button_read();
+			app.bootselDown = bootsel_read();
 
-			if ( tud_suspended() && btn )
+			if ( tud_suspended() && app.bootselDown )
 			{
 				tud_remote_wakeup();
 			}
@@ -694,32 +1336,28 @@ int main()
 		if ( app.updateTimer >= app.updateRate )
 		{
 			app.updateTimer -= app.updateRate;
+			worked = true;
 
 			if ( !app.startResetTimer )
 			{
-				if ( board_button_read() )
+				if ( app.bootselDown )
 				{
 					app.startResetTimer = true;
 					watchdog_enable( 2 * 1000, 1 );
 				}
 
-				watchdog_update();
+				watchdog_feed();
 			}
 			else
 			{
-				if ( !board_button_read() )
+				if ( !app.bootselDown )
 				{
 					app.startResetTimer = false;
 					watchdog_enable( 200, 1 );
-					watchdog_update();
+					watchdog_feed();
 				}
 			}
 
-			u16 keysDown = rgbKeypad.get_button_states();
-			u16 keysPressed = ~keysDownLast & keysDown;
-
-			keysDownLast = keysDown;
-
 			app.rainbowColourTimer += 1;
 
 			if ( app.rainbowColourTimer >= app.rainbowColourUpdateRate )
@@ -728,150 +1366,28 @@ int main()
 				app.rainbowHSVColour.r = ( app.rainbowHSVColour.r + 1 ) % 32;
 			}
 
-			switch ( app.mode )
-			{
-			case APP_MODE::PROGRAMMING_LBOE:
-				{
-					mode_selection( keysPressed, keysDown );
-					key_check( KEYBOARD_MODIFIER_LEFTALT | KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT, keysPressed, keysDown );
-				}
-				break;
-
-			case APP_MODE::PROGRAMMING_GBC:
-				{
-					mode_selection( keysPressed, keysDown );
-					key_check( KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT, keysPressed, keysDown );
-				}
-				break;
+			app_update();
 
-			case APP_MODE::PROGRAMMING_PICO_PROJECT:
-				{
-					mode_selection( keysPressed, keysDown );
-					key_check( KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_RIGHTCTRL | KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT, keysPressed, keysDown );
-				}
-				break;
+			// Hand the frame to core1, if it is behind keep the changes for the next one
+			if ( !app.ledFrames.full() )
+			{
+				RGBKeypad::Frame frame;
 
-			case APP_MODE::KEYBINDS:
-				{
-					mode_selection( keysPressed, keysDown );
-					key_check( KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT, keysPressed, keysDown );
-				}
-				break;
+				app.compositor.flush( &rgbKeypad );
 
-			case APP_MODE::GAME_PHOTON_SMASH:
-				if ( board_button_read() )
+				if ( rgbKeypad.take_frame( frame.data ) )
 				{
-					// Exit game
-					app_switch_mode( app.photonSmash.prevMode );
+					app.ledFrames.push( frame );
 				}
-				else
-				{
-					switch ( app.photonSmash.state )
-					{
-					case PHOTON_SMASH_STATE::GAME:
-						if ( app.photonSmash.rainbowLevel )
-						{
-							rgbKeypad.set_colour( hsv_to_rgb( app.rainbowHSVColour ) );
-						}
-
-						if ( keysPressed )
-						{
-							i32 index = 0;
-							while ( ( keysPressed & 1 ) == 0 )
-							{
-								++index;
-								keysPressed >>= 1;
-							}
-
-							toggle_light( index );
-
-							// Check its not at the top edge
-							if ( index > 3 )
-							{
-								toggle_light( index - 4 );
-							}
-
-							// Check its not at the bottom edge
-							if ( index < 12 )
-							{
-								toggle_light( index + 4 );
-							}
-
-							// Check its not at the left edge
-							if ( index % 4 != 0 )
-							{
-								toggle_light( index - 1 );
-							}
-
-							// Check its not at the right edge
-							if ( ( index + 1 ) % 4 != 0 )
-							{
-								toggle_light( index + 1 );
-							}
-
-							// Check win condition
-							bool won = true;
-
-							for ( u8 i = 0; i < RGBKeypad::NUM_PADS; ++i )
-							{
-								if ( rgbKeypad.get_brightness( i ) != 0 )
-								{
-									won = false;
-									break;
-								}
-							}
-
-							if ( won )
-							{
-								app.photonSmash.state = PHOTON_SMASH_STATE::WIN_ANIMATION;
-								app.photonSmash.level += 1;
-								app.photonSmash.animationTime = 0;
-							}
-						}
-						break;
-
-					case PHOTON_SMASH_STATE::WIN_ANIMATION:
-						{
-							if ( app.photonSmash.animationTime == 0 )
-							{
-								rgbKeypad.set_brightness( 0.5f );
-							}
-
-							app.photonSmash.animationTime += app.updateRate;
-
-							rgbKeypad.set_colour( ( ( app.photonSmash.animationTime / 250 ) & 1 ) ? COLOUR_GREEN : COLOUR_WHITE );
-
-							if ( app.photonSmash.animationTime >= 1000 )
-							{
-								app_switch_mode( APP_MODE::GAME_PHOTON_SMASH );
-							}
-						}
-						break;
-
-					case PHOTON_SMASH_STATE::UNSOLVABLE_ANIMATION:
-						{
-							if ( app.photonSmash.animationTime == 0 )
-							{
-								rgbKeypad.set_brightness( 0.5f );
-							}
-
-							app.photonSmash.animationTime += app.updateRate;
-
-							rgbKeypad.set_colour( ( ( app.photonSmash.animationTime / 250 ) & 1 ) ? COLOUR_RED : COLOUR_YELLOW );
-
-							if ( app.photonSmash.animationTime >= 1500 )
-							{
-								app_switch_mode( app.photonSmash.prevMode );
-							}
-						}
-						break;
-					}
-				}
-				break;
 			}
+		}
 
-			rgbKeypad.update();
+		if ( worked )
+		{
+			app.core0Load.add( startTime );
 		}
+
+		app.core0Load.update();
 	}
 
 	queue_free( &app.keyQueue );
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string.h>
+
+#include "types.h"
+
+// A pad as one word in apa102 wire order, read little endian: header, b, g, r from the
+// low byte up. The channels and the brightness are 5 bit, so each byte has 3 spare bits
+// and all four can be worked on at once with plain integer ops (swar).
+using PackedColour = u32;
+
+constexpr u32 PACKED_HEADER = 0x000000E0;			// top 3 bits of the brightness byte, always set
+constexpr u32 PACKED_LANES = 0x1F1F1F1F;			// brightness, b, g, r
+constexpr u32 PACKED_CARRIES = 0x20202020;			// set in a lane that went over 31
+constexpr u32 PACKED_EVEN = 0x001F001F;				// brightness and g, 16 bits each to multiply in
+constexpr u32 PACKED_ODD = 0x1F001F00;				// b and r
+
+[[nodiscard]] constexpr PackedColour pack_colour( Colour colour, u8 brightness )
+{
+	return PACKED_HEADER | ( brightness & 0b00011111u ) | ( colour.b << 8 ) | ( colour.g << 16 ) | ( static_cast<u32>( colour.r ) << 24 );
+}
+
+[[nodiscard]] constexpr Colour unpack_colour( PackedColour colour )
+{
+	return { static_cast<u8>( colour >> 24 ), static_cast<u8>( colour >> 16 ), static_cast<u8>( colour >> 8 ) };
+}
+
+[[nodiscard]] constexpr u8 packed_brightness( PackedColour colour )
+{
+	return static_cast<u8>( colour & 0b00011111 );
+}
+
+// Every lane a + b, held at 31
+[[nodiscard]] constexpr PackedColour packed_add_saturate( PackedColour a, PackedColour b )
+{
+	u32 sum = ( a & PACKED_LANES ) + ( b & PACKED_LANES );		// at most 62 a lane, no carry between them
+	u32 over = ( ( sum & PACKED_CARRIES ) >> 5 ) * 0x1F;		// 31 in each lane that went over
+
+	return PACKED_HEADER | ( ( sum | over ) & PACKED_LANES );
+}
+
+// Every lane scaled by a Q8 fraction (0-256), brightness included
+[[nodiscard]] constexpr PackedColour packed_scale_q8( PackedColour colour, u32 fraction )
+{
+	u32 even = ( colour & PACKED_EVEN ) * fraction;
+	u32 odd = ( ( colour & PACKED_ODD ) >> 8 ) * fraction;
+
+	return PACKED_HEADER | ( ( even >> 8 ) & PACKED_EVEN ) | ( odd & PACKED_ODD );
+}
+
+// a -> b by a Q8 fraction (0-256), every lane rounds the same as lerp_q8 on its own would
+[[nodiscard]] constexpr PackedColour packed_lerp_q8( PackedColour a, PackedColour b, u32 fraction )
+{
+	u32 even = ( a & PACKED_EVEN ) * ( 256 - fraction ) + ( b & PACKED_EVEN ) * fraction;
+	u32 odd = ( ( a & PACKED_ODD ) >> 8 ) * ( 256 - fraction ) + ( ( b & PACKED_ODD ) >> 8 ) * fraction;
+
+	return PACKED_HEADER | ( ( even >> 8 ) & PACKED_EVEN ) | ( odd & PACKED_ODD );
+}
+
+static_assert( packed_add_saturate( pack_colour( { 20, 31, 0 }, 16 ), pack_colour( { 20, 1, 5 }, 31 ) ) == pack_colour( { 31, 31, 5 }, 31 ) );
+static_assert( packed_scale_q8( pack_colour( { 31, 16, 1 }, 31 ), 128 ) == pack_colour( { 15, 8, 0 }, 15 ) );
+static_assert( packed_lerp_q8( pack_colour( { 31, 0, 10 }, 0 ), pack_colour( { 0, 31, 20 }, 31 ), 64 ) == pack_colour( { 23, 7, 12 }, 7 ) );
+static_assert( packed_lerp_q8( pack_colour( { 31, 31, 31 }, 31 ), pack_colour( { 0, 0, 0 }, 0 ), 256 ) == pack_colour( { 0, 0, 0 }, 0 ) );
+
+// A pad in place in a byte buffer, such as the led data, which must be 4 byte aligned
+[[nodiscard]] inline PackedColour load_packed( const u8 *pad )
+{
+	PackedColour colour;
+	memcpy( &colour, __builtin_assume_aligned( pad, 4 ), sizeof( colour ) );
+	return colour;
+}
+
+inline void store_packed( u8 *pad, PackedColour colour )
+{
+	memcpy( __builtin_assume_aligned( pad, 4 ), &colour, sizeof( colour ) );
+}
+
+// Spans, a whole frame of pads in one call. out can be one of the inputs.
+inline void colour_span_pack( PackedColour *out, const Colour *colours, u8 brightness, i32 count )
+{
+	for ( i32 i = 0; i < count; ++i )
+		out[ i ] = pack_colour( colours[ i ], brightness );
+}
+
+inline void colour_span_unpack( Colour *out, const PackedColour *colours, i32 count )
+{
+	for ( i32 i = 0; i < count; ++i )
+		out[ i ] = unpack_colour( colours[ i ] );
+}
+
+inline void colour_span_add_saturate( PackedColour *out, const PackedColour *a, const PackedColour *b, i32 count )
+{
+	for ( i32 i = 0; i < count; ++i )
+		out[ i ] = packed_add_saturate( a[ i ], b[ i ] );
+}
+
+inline void colour_span_scale_q8( PackedColour *out, const PackedColour *colours, u32 fraction, i32 count )
+{
+	for ( i32 i = 0; i < count; ++i )
+		out[ i ] = packed_scale_q8( colours[ i ], fraction );
+}
+
+inline void colour_span_lerp_q8( PackedColour *out, const PackedColour *a, const PackedColour *b, u32 fraction, i32 count )
+{
+	for ( i32 i = 0; i < count; ++i )
+		out[ i ] = packed_lerp_q8( a[ i ], b[ i ], fraction );
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "types.h"
+#include "rgb_keypad.h"
+
+// The board is a bit per pad, set is lit
+static_assert( RGBKeypad::WIDTH == 4 && RGBKeypad::HEIGHT == 4, "Photon Smash is played on one 4x4 keypad" );
+
+struct PhotonSmashPressMasks
+{
+	u16 masks[ RGBKeypad::NUM_PADS ];
+};
+
+// Pads a press toggles, itself and its neighbours that are on the board
+constexpr PhotonSmashPressMasks make_press_masks()
+{
+	PhotonSmashPressMasks table = {};
+
+	for ( i32 index = 0; index < RGBKeypad::NUM_PADS; ++index )
+	{
+		i32 x = index % RGBKeypad::WIDTH;
+		i32 y = index / RGBKeypad::WIDTH;
+		u16 mask = static_cast<u16>( 1 << index );
+
+		if ( y > 0 )
+			mask |= 1 << ( index - RGBKeypad::WIDTH );
+
+		if ( y < RGBKeypad::HEIGHT - 1 )
+			mask |= 1 << ( index + RGBKeypad::WIDTH );
+
+		if ( x > 0 )
+			mask |= 1 << ( index - 1 );
+
+		if ( x < RGBKeypad::WIDTH - 1 )
+			mask |= 1 << ( index + 1 );
+
+		table.masks[ index ] = mask;
+	}
+
+	return table;
+}
+
+constexpr PhotonSmashPressMasks photonSmashPressMasks = make_press_masks();
+
+static_assert( photonSmashPressMasks.masks[ 0 ] == 0b0000'0000'0001'0011 );
+static_assert( photonSmashPressMasks.masks[ 5 ] == 0b0000'0010'0111'0010 );
+static_assert( photonSmashPressMasks.masks[ 15 ] == 0b1100'1000'0000'0000 );
+
+// Chase the lights down a row at a time, pressing under each lit pad. Only the bottom row can be
+// left lit, and if it is the board can't be cleared.
+[[nodiscard]] constexpr bool photon_smash_solvable( u16 board )
+{
+	for ( i32 index = RGBKeypad::WIDTH; index < RGBKeypad::NUM_PADS; ++index )
+	{
+		if ( board & ( 1 << ( index - RGBKeypad::WIDTH ) ) )
+		{
+			board ^= photonSmashPressMasks.masks[ index ];
+		}
+	}
+
+	return board == 0;
+}
@@ -1,10 +1,13 @@
 
-// This code is splitmix64 & xoshiro256starstar & xoshiro256plus
+// This code is splitmix64 & xoshiro256starstar & xoshiro256plus & xoshiro128starstar & xoshiro128plus & pcg32
 // It has been slightly changed to fit my project.
 // For the original code see the links:
 // https://prng.di.unimi.it/splitmix64.c
 // https://xoshiro.di.unimi.it/xoshiro256starstar.c
 // https://xoshiro.di.unimi.it/xoshiro256plus.c
+// https://prng.di.unimi.it/xoshiro128starstar.c
+// https://prng.di.unimi.it/xoshiro128plus.c
+// https://www.pcg-random.org/download.html#minimal-c-implementation
 // ------------------------------------------------------------------------------------
 // splitmix64
 // Source Code: https://prng.di.unimi.it/splitmix64.c
@@ -41,71 +44,103 @@
 // worldwide. This software is distributed without any warranty.
 // ------------------------------------------------------------------------------------
 
-#include "pico/stdlib.h"
+// 
+// ------------------------------------------------------------------------------------
+// xoshiro128starstar & xoshiro128plus
+// Source Code: https://prng.di.unimi.it/xoshiro128starstar.c
+//              https://prng.di.unimi.it/xoshiro128plus.c
+// License:
+// ------------------------------------------------------------------------------------
+// Written in 2018 by David Blackman and Sebastiano Vigna (vigna@acm.org)
+// 
+// To the extent possible under law, the author has dedicated all copyright
+// and related and neighboring rights to this software to the public domain
+// worldwide. This software is distributed without any warranty.
+// ------------------------------------------------------------------------------------
+// 
+// ------------------------------------------------------------------------------------
+// pcg32
+// Source Code: https://www.pcg-random.org/download.html#minimal-c-implementation
+// License:
+// ------------------------------------------------------------------------------------
+// *Really* minimal PCG32 code / (c) 2014 M.E. O'Neill / pcg-random.org
+// Licensed under Apache License 2.0 (NO WARRANTY, etc. see website)
+// ------------------------------------------------------------------------------------
 
-#include "random.h"
+#include <math.h>
+#include <string.h>
 
-template <typename T>
-T sign( T a )
-{
-	return a > 0 ? +1 : ( a < 0 ? -1 : 0 );
-}
+#ifdef LPAD_HOST
+	#include <stdint.h>
+#else
+	#include "pico/stdlib.h"
+#endif
+
+#include "random.h"
 
 [[nodiscard]] static inline u64 rotl( const u64 x, const i32 k )
 {
 	return ( x << k ) | ( x >> ( 64 - k ) );
 }
 
-struct Splitmix64
+[[nodiscard]] static inline u32 rotl( const u32 x, const i32 k )
 {
-	u64 state;
+	return ( x << k ) | ( x >> ( 32 - k ) );
+}
 
-	u64 next()
-	{
-		u64 z = ( state += 0x9e3779b97f4a7c15 );
-		z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9;
-		z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111eb;
-		return z ^ ( z >> 31 );
-	}
-};
+u64 Splitmix64::next()
+{
+	return mix( state += 0x9e3779b97f4a7c15 );
+}
 
-struct Xoshiro256starstar
+u64 Splitmix64::mix( u64 z )
 {
-	u64 state[ 4 ];
+	z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9;
+	z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111eb;
+	return z ^ ( z >> 31 );
+}
 
-	u64 next();
+// -------------------------------------------------------
+// Counter based, splitmix64's finaliser over key + stream and index spread by two odd constants.
+// The index uses splitmix64's own increment so consecutive indices are consecutive splitmix states.
+// -------------------------------------------------------
 
-	/* This is the jump function for the generator. It is equivalent
-	   to 2^128 calls to next(); it can be used to generate 2^128
-	   non-overlapping subsequences for parallel computations. */
-	void jump();
+static u64 counterKey;
 
-	/* This is the long-jump function for the generator. It is equivalent to
-	   2^192 calls to next(); it can be used to generate 2^64 starting poi32s,
-	   from each of which jump() will generate 2^64 non-overlapping
-	   subsequences for parallel distributed computations. */
-	void long_jump();
-};
+static constexpr u64 COUNTER_STREAM = 0xd1b54a32d192ed03;
+static constexpr u64 COUNTER_INDEX = 0x9e3779b97f4a7c15;
+static constexpr u64 COUNTER_RETRY = 0x8cb92ba72f3d8dd7;
 
-struct Xoshiro256plus
+[[nodiscard]] u64 random_at( u64 stream, u64 index )
 {
-	u64 state[ 4 ];
+	return Splitmix64::mix( counterKey + stream * COUNTER_STREAM + index * COUNTER_INDEX );
+}
 
-	u64 next();
-	f32 nextf();
-	f64 nextd();
+[[nodiscard]] u32 irandom_at( u64 stream, u64 index, u32 max )
+{
+	u32 range = max + 1;
+	u64 z = counterKey + stream * COUNTER_STREAM + index * COUNTER_INDEX;
+	u64 x = Splitmix64::mix( z ) >> 32;
 
-	/* This is the jump function for the generator. It is equivalent
-	   to 2^128 calls to next(); it can be used to generate 2^128
-	   non-overlapping subsequences for parallel computations. */
-	void jump();
+	if ( range == 0 )
+		return static_cast<u32>( x );
 
-	/* This is the long-jump function for the generator. It is equivalent to
-	   2^192 calls to next(); it can be used to generate 2^64 starting poi32s,
-	   from each of which jump() will generate 2^64 non-overlapping
-	   subsequences for parallel distributed computations. */
-	void long_jump();
-};
+	u64 m = x * range;
+
+	// Same rejection as bounded(), a rejected draw moves the hash on a step
+	if ( static_cast<u32>( m ) < range )
+	{
+		u32 threshold = ( 0u - range ) % range;
+
+		while ( static_cast<u32>( m ) < threshold )
+		{
+			z += COUNTER_RETRY;
+			m = ( Splitmix64::mix( z ) >> 32 ) * range;
+		}
+	}
+
+	return static_cast<u32>( m >> 32 );
+}
 
 // -------------------------------------------------------
 
@@ -136,7 +171,7 @@ void Xoshiro256starstar::jump()
 	u64 s2 = 0;
 	u64 s3 = 0;
 
-	for ( i32 i = 0; i < sizeof JUMP / sizeof *JUMP; ++i )
+	for ( i32 i = 0; i < ARRAY_LENGTH( JUMP ); ++i )
 	{
 		for ( i32 b = 0; b < 64; ++b )
 		{
@@ -167,7 +202,7 @@ void Xoshiro256starstar::long_jump()
 	u64 s2 = 0;
 	u64 s3 = 0;
 
-	for ( i32 i = 0; i < sizeof LONG_JUMP / sizeof *LONG_JUMP; ++i )
+	for ( i32 i = 0; i < ARRAY_LENGTH( LONG_JUMP ); ++i )
 	{
 		for ( i32 b = 0; b < 64; ++b )
 		{
@@ -209,16 +244,6 @@ u64 Xoshiro256plus::next()
 	return result;
 }
 
-inline f32 Xoshiro256plus::nextf()
-{
-	return static_cast<f32>( next() >> 11 ) * ( 1.f / ( UINT64_C( 1 ) << 53 ) );
-}
-
-inline f64 Xoshiro256plus::nextd()
-{
-	return static_cast<double>( next() >> 11 ) * ( 1. / ( UINT64_C( 1 ) << 53 ) );
-}
-
 void Xoshiro256plus::jump()
 {
 	static const u64 JUMP[] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
@@ -228,7 +253,7 @@ void Xoshiro256plus::jump()
 	u64 s2 = 0;
 	u64 s3 = 0;
 
-	for ( i32 i = 0; i < sizeof JUMP / sizeof *JUMP; ++i )
+	for ( i32 i = 0; i < ARRAY_LENGTH( JUMP ); ++i )
 	{
 		for ( i32 b = 0; b < 64; ++b )
 		{
@@ -259,7 +284,7 @@ void Xoshiro256plus::long_jump()
 	u64 s2 = 0;
 	u64 s3 = 0;
 
-	for ( i32 i = 0; i < sizeof LONG_JUMP / sizeof *LONG_JUMP; ++i )
+	for ( i32 i = 0; i < ARRAY_LENGTH( LONG_JUMP ); ++i )
 	{
 		for ( i32 b = 0; b < 64; ++b )
 		{
@@ -282,62 +307,309 @@ void Xoshiro256plus::long_jump()
 }
 
 // -------------------------------------------------------
+// Seeding and state, the same for both 256 bit engines
+// -------------------------------------------------------
+
+template <typename Xoshiro256>
+static void xoshiro256_seed( Xoshiro256 *xoshiro, Splitmix64 *splitmix )
+{
+	for ( i32 i = 0; i < 4; ++i )
+		xoshiro->state[ i ] = splitmix->next();
+}
+
+void Xoshiro256starstar::seed( Splitmix64 *splitmix ) { xoshiro256_seed( this, splitmix ); }
+void Xoshiro256plus::seed( Splitmix64 *splitmix ) { xoshiro256_seed( this, splitmix ); }
+
+void Xoshiro256starstar::set_state( const u64 words[ STATE_WORDS ] ) { memcpy( state, words, sizeof( state ) ); }
+void Xoshiro256plus::set_state( const u64 words[ STATE_WORDS ] ) { memcpy( state, words, sizeof( state ) ); }
+
+void Xoshiro256starstar::get_state( u64 words[ STATE_WORDS ] ) { memcpy( words, state, sizeof( state ) ); }
+void Xoshiro256plus::get_state( u64 words[ STATE_WORDS ] ) { memcpy( words, state, sizeof( state ) ); }
+
+// -------------------------------------------------------
+
+u32 Xoshiro128starstar::next()
+{
+	const u32 result = rotl( state[ 1 ] * 5, 7 ) * 9;
+
+	const u32 t = state[ 1 ] << 9;
+
+	state[ 2 ] ^= state[ 0 ];
+	state[ 3 ] ^= state[ 1 ];
+	state[ 1 ] ^= state[ 2 ];
+	state[ 0 ] ^= state[ 3 ];
+
+	state[ 2 ] ^= t;
+
+	state[ 3 ] = rotl( state[ 3 ], 11 );
+
+	return result;
+}
+
+u32 Xoshiro128plus::next()
+{
+	const u32 result = state[ 0 ] + state[ 3 ];
+
+	const u32 t = state[ 1 ] << 9;
+
+	state[ 2 ] ^= state[ 0 ];
+	state[ 3 ] ^= state[ 1 ];
+	state[ 1 ] ^= state[ 2 ];
+	state[ 0 ] ^= state[ 3 ];
+
+	state[ 2 ] ^= t;
+
+	state[ 3 ] = rotl( state[ 3 ], 11 );
+
+	return result;
+}
+
+/* The jump is equivalent to 2^64 calls to next(), the long jump to 2^96.
+   Both are the same for the ** and + scramblers. */
+template <typename Xoshiro128>
+static void xoshiro128_jump( Xoshiro128 *xoshiro, const u32 ( &jump )[ 4 ] )
+{
+	u32 s0 = 0;
+	u32 s1 = 0;
+	u32 s2 = 0;
+	u32 s3 = 0;
+
+	for ( i32 i = 0; i < 4; ++i )
+	{
+		for ( i32 b = 0; b < 32; ++b )
+		{
+			if ( jump[ i ] & UINT32_C( 1 ) << b )
+			{
+				s0 ^= xoshiro->state[ 0 ];
+				s1 ^= xoshiro->state[ 1 ];
+				s2 ^= xoshiro->state[ 2 ];
+				s3 ^= xoshiro->state[ 3 ];
+			}
+
+			xoshiro->next();
+		}
+	}
+
+	xoshiro->state[ 0 ] = s0;
+	xoshiro->state[ 1 ] = s1;
+	xoshiro->state[ 2 ] = s2;
+	xoshiro->state[ 3 ] = s3;
+}
+
+static const u32 XOSHIRO128_JUMP[] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+static const u32 XOSHIRO128_LONG_JUMP[] = { 0xb523952e, 0x0b6f099f, 0xccf5a0ef, 0x1c580662 };
+
+void Xoshiro128starstar::jump() { xoshiro128_jump( this, XOSHIRO128_JUMP ); }
+void Xoshiro128plus::jump() { xoshiro128_jump( this, XOSHIRO128_JUMP ); }
+void Xoshiro128starstar::long_jump() { xoshiro128_jump( this, XOSHIRO128_LONG_JUMP ); }
+void Xoshiro128plus::long_jump() { xoshiro128_jump( this, XOSHIRO128_LONG_JUMP ); }
+
+template <typename Xoshiro128>
+static void xoshiro128_seed( Xoshiro128 *xoshiro, Splitmix64 *splitmix )
+{
+	for ( i32 i = 0; i < 4; i += 2 )
+	{
+		u64 word = splitmix->next();
+		xoshiro->state[ i + 0 ] = static_cast<u32>( word );
+		xoshiro->state[ i + 1 ] = static_cast<u32>( word >> 32 );
+	}
+}
+
+void Xoshiro128starstar::seed( Splitmix64 *splitmix ) { xoshiro128_seed( this, splitmix ); }
+void Xoshiro128plus::seed( Splitmix64 *splitmix ) { xoshiro128_seed( this, splitmix ); }
+
+void Xoshiro128starstar::set_state( const u64 words[ STATE_WORDS ] ) { memcpy( state, words, sizeof( state ) ); }
+void Xoshiro128plus::set_state( const u64 words[ STATE_WORDS ] ) { memcpy( state, words, sizeof( state ) ); }
 
-static Splitmix64 splitmix64;
-static Xoshiro256starstar xoshiro256starstar;
-static Xoshiro256plus xoshiro256plus;
+void Xoshiro128starstar::get_state( u64 words[ STATE_WORDS ] ) { memcpy( words, state, sizeof( state ) ); }
+void Xoshiro128plus::get_state( u64 words[ STATE_WORDS ] ) { memcpy( words, state, sizeof( state ) ); }
+
+// -------------------------------------------------------
+
+u32 Pcg32::next()
+{
+	u64 oldState = state;
+
+	state = oldState * 6364136223846793005ULL + increment;
+
+	u32 xorShifted = static_cast<u32>( ( ( oldState >> 18u ) ^ oldState ) >> 27u );
+	u32 rot = static_cast<u32>( oldState >> 59u );
+
+	return ( xorShifted >> rot ) | ( xorShifted << ( ( 0u - rot ) & 31 ) );
+}
+
+void Pcg32::seed( Splitmix64 *splitmix )
+{
+	u64 initState = splitmix->next();
+	u64 initSequence = splitmix->next();
+
+	state = 0;
+	increment = ( initSequence << 1u ) | 1u;
+	next();
+	state += initState;
+	next();
+}
+
+void Pcg32::set_state( const u64 words[ STATE_WORDS ] )
+{
+	state = words[ 0 ];
+	increment = words[ 1 ] | 1u;
+}
+
+void Pcg32::get_state( u64 words[ STATE_WORDS ] )
+{
+	words[ 0 ] = state;
+	words[ 1 ] = increment;
+}
+
+// Brown, "Random Number Generation with Arbitrary Strides", the lcg composed with itself by squaring
+void Pcg32::advance( u64 delta )
+{
+	u64 accMultiplier = 1;
+	u64 accIncrement = 0;
+	u64 multiplier = 6364136223846793005ULL;
+	u64 step = increment;
+
+	while ( delta )
+	{
+		if ( delta & 1 )
+		{
+			accMultiplier *= multiplier;
+			accIncrement = accIncrement * multiplier + step;
+		}
+
+		step = ( multiplier + 1 ) * step;
+		multiplier *= multiplier;
+		delta >>= 1;
+	}
+
+	state = accMultiplier * state + accIncrement;
+}
+
+void Pcg32::jump()
+{
+	advance( UINT64_C( 1 ) << 32 );
+	increment = ( Splitmix64::mix( increment ) << 1 ) | 1u;
+}
+
+void Pcg32::long_jump()
+{
+	advance( UINT64_C( 1 ) << 48 );
+	increment = ( Splitmix64::mix( ~increment ) << 1 ) | 1u;
+}
 
 // --------------------------------------------------------------------------------------------------------------------------------
-// End of modified xoshiro256starstar & splitmix64
+// End of modified xoshiro256starstar & xoshiro256plus & xoshiro128starstar & xoshiro128plus & pcg32 & splitmix64
 // --------------------------------------------------------------------------------------------------------------------------------
 
-void random_set_seed( u64 seed )
+template <typename Engine>
+void Random<Engine>::set_seed( u64 seed )
+{
+	Splitmix64 splitmix { seed };
+
+	engine.seed( &splitmix );
+}
+
+template <typename Engine>
+void Random<Engine>::fill( u32 *out, u32 count )
+{
+	for ( u32 i = 0; i < count; ++i )
+	{
+		out[ i ] = engine.next32();
+	}
+}
+
+// -------------------------------------------------------
+// Bounded integers without floats or division, Lemire's multiply and shift
+// https://arxiv.org/abs/1805.10941
+// The low word of the product says if this draw landed in the biased part
+// of the range, those are rejected so every result is exactly as likely.
+// A range of 0 means the whole type.
+// -------------------------------------------------------
+
+template <typename Engine>
+[[nodiscard]] u32 Random<Engine>::bounded( u32 range )
 {
-	splitmix64.state = seed;
-	xoshiro256starstar.state[ 0 ] = splitmix64.next();
-	xoshiro256starstar.state[ 1 ] = splitmix64.next();
-	xoshiro256starstar.state[ 2 ] = splitmix64.next();
-	xoshiro256starstar.state[ 3 ] = splitmix64.next();
-	xoshiro256plus.state[ 0 ] = splitmix64.next();
-	xoshiro256plus.state[ 1 ] = splitmix64.next();
-	xoshiro256plus.state[ 2 ] = splitmix64.next();
-	xoshiro256plus.state[ 3 ] = splitmix64.next();
+	u32 x = engine.next32();
+
+	if ( range == 0 )
+		return x;
+
+	u64 m = static_cast<u64>( x ) * range;
+	u32 low = static_cast<u32>( m );
+
+	if ( low < range )
+	{
+		// Only now pay for the division, it's rare for small ranges
+		u32 threshold = ( 0u - range ) % range;
+
+		while ( low < threshold )
+		{
+			x = engine.next32();
+			m = static_cast<u64>( x ) * range;
+			low = static_cast<u32>( m );
+		}
+	}
+
+	return static_cast<u32>( m >> 32 );
 }
 
-void random_set_seed( const u64 seed[ 9 ] )
+// 64x64 multiply to the high and low words, there's no 128 bit type on the m0+
+[[nodiscard]] static inline u64 mul_64( u64 a, u64 b, u64 *low )
 {
-	splitmix64.state = seed[ 0 ];
-	xoshiro256starstar.state[ 0 ] = seed[ 1 ];
-	xoshiro256starstar.state[ 1 ] = seed[ 2 ];
-	xoshiro256starstar.state[ 2 ] = seed[ 3 ];
-	xoshiro256starstar.state[ 3 ] = seed[ 4 ];
-	xoshiro256plus.state[ 0 ] = seed[ 5 ];
-	xoshiro256plus.state[ 1 ] = seed[ 6 ];
-	xoshiro256plus.state[ 2 ] = seed[ 7 ];
-	xoshiro256plus.state[ 3 ] = seed[ 8 ];
+	u64 aLow = static_cast<u32>( a );
+	u64 aHigh = a >> 32;
+	u64 bLow = static_cast<u32>( b );
+	u64 bHigh = b >> 32;
+
+	u64 ll = aLow * bLow;
+	u64 lh = aLow * bHigh;
+	u64 hl = aHigh * bLow;
+	u64 hh = aHigh * bHigh;
+
+	u64 middle = ( ll >> 32 ) + static_cast<u32>( lh ) + static_cast<u32>( hl );
+
+	*low = ( middle << 32 ) | static_cast<u32>( ll );
+
+	return hh + ( lh >> 32 ) + ( hl >> 32 ) + ( middle >> 32 );
 }
 
-void random_get_state( u64 state[ 9 ] )
+template <typename Engine>
+[[nodiscard]] u64 Random<Engine>::bounded( u64 range )
 {
-	state[ 0 ] = splitmix64.state;
-	state[ 1 ] = xoshiro256starstar.state[ 0 ];
-	state[ 2 ] = xoshiro256starstar.state[ 1 ];
-	state[ 3 ] = xoshiro256starstar.state[ 2 ];
-	state[ 4 ] = xoshiro256starstar.state[ 3 ];
-	state[ 5 ] = xoshiro256plus.state[ 0 ];
-	state[ 6 ] = xoshiro256plus.state[ 1 ];
-	state[ 7 ] = xoshiro256plus.state[ 2 ];
-	state[ 8 ] = xoshiro256plus.state[ 3 ];
+	if ( range == 0 )
+		return engine.next64();
+
+	// Small ranges only need the 32 bit path
+	if ( range <= UINT32_MAX )
+		return bounded( static_cast<u32>( range ) );
+
+	u64 low;
+	u64 high = mul_64( engine.next64(), range, &low );
+
+	if ( low < range )
+	{
+		u64 threshold = ( 0u - range ) % range;
+
+		while ( low < threshold )
+		{
+			high = mul_64( engine.next64(), range, &low );
+		}
+	}
+
+	return high;
 }
 
 // -------------------------------------------------------
 
-[[nodiscard]] u32 irandom( u32 max )
+template <typename Engine>
+[[nodiscard]] u32 Random<Engine>::irandom( u32 max )
 {
-	return static_cast<u32>( xoshiro256plus.nextf() * ( max + 1 ) );
+	return bounded( max + 1 );
 }
 
-[[nodiscard]] u32 irandom_range( u32 min, u32 max )
+template <typename Engine>
+[[nodiscard]] u32 Random<Engine>::irandom_range( u32 min, u32 max )
 {
 	if ( min > max )
 	{
@@ -346,15 +618,21 @@ void random_get_state( u64 state[ 9 ] )
 		max = temp;
 	}
 
-	return min + static_cast<u32>( xoshiro256plus.nextf() * ( max - min + 1 ) );
+	return min + bounded( max - min + 1 );
 }
 
-[[nodiscard]] i32 irandom( i32 max )
+template <typename Engine>
+[[nodiscard]] i32 Random<Engine>::irandom( i32 max )
 {
-	return static_cast<i32>( xoshiro256plus.nextf() * ( max + sign( max ) ) );
+	// A negative max ranges from max to 0
+	if ( max < 0 )
+		return static_cast<i32>( 0u - bounded( 0u - static_cast<u32>( max ) + 1 ) );
+
+	return static_cast<i32>( bounded( static_cast<u32>( max ) + 1 ) );
 }
 
-[[nodiscard]] i32 irandom_range( i32 min, i32 max )
+template <typename Engine>
+[[nodiscard]] i32 Random<Engine>::irandom_range( i32 min, i32 max )
 {
 	if ( min > max )
 	{
@@ -363,15 +641,21 @@ void random_get_state( u64 state[ 9 ] )
 		max = temp;
 	}
 
-	return min + static_cast<i32>( xoshiro256plus.nextf() * ( max - min + 1 ) );
+	return static_cast<i32>( static_cast<u32>( min ) + bounded( static_cast<u32>( max ) - static_cast<u32>( min ) + 1 ) );
 }
 
-[[nodiscard]] i64 irandom( i64 max )
+template <typename Engine>
+[[nodiscard]] i64 Random<Engine>::irandom( i64 max )
 {
-	return static_cast<i64>( xoshiro256plus.nextf() * ( max + sign( max ) ) );
+	// A negative max ranges from max to 0
+	if ( max < 0 )
+		return static_cast<i64>( 0u - bounded( static_cast<u64>( 0u - static_cast<u64>( max ) + 1 ) ) );
+
+	return static_cast<i64>( bounded( static_cast<u64>( max ) + 1 ) );
 }
 
-[[nodiscard]] i64 irandom_range( i64 min, i64 max )
+template <typename Engine>
+[[nodiscard]] i64 Random<Engine>::irandom_range( i64 min, i64 max )
 {
 	if ( min > max )
 	{
@@ -380,15 +664,17 @@ void random_get_state( u64 state[ 9 ] )
 		max = temp;
 	}
 
-	return min + static_cast<i64>( xoshiro256plus.nextf() * ( max - min + 1 ) );
+	return static_cast<i64>( static_cast<u64>( min ) + bounded( static_cast<u64>( max ) - static_cast<u64>( min ) + 1 ) );
 }
 
-[[nodiscard]] u64 irandom( u64 max )
+template <typename Engine>
+[[nodiscard]] u64 Random<Engine>::irandom( u64 max )
 {
-	return static_cast<u64>( xoshiro256plus.nextf() * ( max + 1 ) );
+	return bounded( max + 1 );
 }
 
-[[nodiscard]] u64 irandom_range( u64 min, u64 max )
+template <typename Engine>
+[[nodiscard]] u64 Random<Engine>::irandom_range( u64 min, u64 max )
 {
 	if ( min > max )
 	{
@@ -397,15 +683,17 @@ void random_get_state( u64 state[ 9 ] )
 		max = temp;
 	}
 
-	return min + static_cast<u64>( xoshiro256plus.nextf() * ( max - min + 1 ) );
+	return min + bounded( max - min + 1 );
 }
 
-[[nodiscard]] f32 random( f32 max )
+template <typename Engine>
+[[nodiscard]] f32 Random<Engine>::random( f32 max )
 {
-	return xoshiro256plus.nextf() * max;
+	return random_f32_0_1() * max;
 }
 
-[[nodiscard]] f32 random_range( f32 min, f32 max )
+template <typename Engine>
+[[nodiscard]] f32 Random<Engine>::random_range( f32 min, f32 max )
 {
 	if ( min > max )
 	{
@@ -414,35 +702,620 @@ void random_get_state( u64 state[ 9 ] )
 		max = temp;
 	}
 
-	return min + static_cast<f32>( xoshiro256plus.nextf() * ( max - min ) );
+	return min + static_cast<f32>( random_f32_0_1() * ( max - min ) );
+}
+
+template <typename Engine>
+[[nodiscard]] f32 Random<Engine>::random_f32_0_1()
+{
+	// Only as many bits as the mantissa holds, more can round up to 1
+	return static_cast<f32>( engine.next32() >> 8 ) * ( 1.f / ( UINT32_C( 1 ) << 24 ) );
+}
+
+template <typename Engine>
+[[nodiscard]] f64 Random<Engine>::random_f64_0_1()
+{
+	return static_cast<f64>( engine.next64() >> 11 ) * ( 1. / ( UINT64_C( 1 ) << 53 ) );
+}
+
+// 2^32 / 100 rounded up, so 100 percent always procs
+static constexpr u64 PERCENT_THRESHOLD = 42949673;
+
+template <typename Engine>
+[[nodiscard]] bool Random<Engine>::iproc( i32 chance )
+{
+	return chance > 0 && engine.next32() < static_cast<u64>( chance ) * PERCENT_THRESHOLD;
 }
 
-[[nodiscard]] f32 random_f32_0_1()
+template <typename Engine>
+[[nodiscard]] bool Random<Engine>::iproc( i64 chance )
 {
-	return xoshiro256plus.nextf();
+	return chance > 0 && ( chance >= 100 || engine.next32() < static_cast<u64>( chance ) * PERCENT_THRESHOLD );
 }
 
-[[nodiscard]] f64 random_f64_0_1()
+template <typename Engine>
+[[nodiscard]] bool Random<Engine>::iproc( u64 chance )
 {
-	return xoshiro256plus.nextd();
+	return chance >= 100 || engine.next32() < chance * PERCENT_THRESHOLD;
 }
 
-[[nodiscard]] bool iproc( i32 chance )
+template <typename Engine>
+[[nodiscard]] bool Random<Engine>::proc( f32 chance )
 {
-	return chance > irandom( static_cast<u32>( 99 ) );
+	// Constant chances should be a Chance. This converts every call so it stays in f32,
+	// chance_percent works in f64 which is all soft float on the m0+.
+	u64 threshold = UINT64_C( 1 ) << 32;
+
+	if ( chance <= 0 )
+		threshold = 0;
+	else if ( chance < 100 )
+		threshold = static_cast<u64>( chance * static_cast<f32>( PERCENT_THRESHOLD ) );
+
+	return engine.next32() < threshold;
 }
 
-[[nodiscard]] bool iproc( i64 chance )
+template <typename Engine>
+[[nodiscard]] bool Random<Engine>::proc( Chance chance )
 {
-	return chance > irandom( static_cast<u32>( 99 ) );
+	return engine.next32() < chance.threshold;
 }
 
-[[nodiscard]] bool iproc( u64 chance )
+template <typename Engine>
+[[nodiscard]] u64 Random<Engine>::random_subset( u32 n, u32 k )
 {
-	return chance > irandom( static_cast<u32>( 99 ) );
+	if ( n > 64 )
+		n = 64;
+
+	if ( k > n )
+		k = n;
+
+	u64 all = n == 64 ? UINT64_MAX : ( UINT64_C( 1 ) << n ) - 1;
+
+	// Picking the ones left out is fewer draws
+	bool invert = k > n / 2;
+
+	if ( invert )
+		k = n - k;
+
+	u64 chosen = 0;
+
+	for ( u32 j = n - k; j < n; ++j )
+	{
+		u64 bit = UINT64_C( 1 ) << bounded( j + 1 );
+
+		// Already taken, then j itself is new
+		chosen |= ( chosen & bit ) ? UINT64_C( 1 ) << j : bit;
+	}
+
+	return invert ? all & ~chosen : chosen;
 }
 
-[[nodiscard]] bool proc( f32 chance )
+template <typename Engine>
+void Random<Engine>::sample_k_of_n( u8 *out, u32 k, u32 n )
 {
-	return static_cast<i32>( chance * 100000 ) > irandom( static_cast<i32>( 99 * 100000 ) );
+	u64 chosen = random_subset( n, k );
+	u32 count = 0;
+
+	for ( ; chosen; chosen &= chosen - 1 )
+	{
+		out[ count++ ] = static_cast<u8>( __builtin_ctzll( chosen ) );
+	}
+
+	// The bits come out in order
+	shuffle( out, count );
 }
+
+// -------------------------------------------------------
+// Ziggurat, Marsaglia & Tsang "The Ziggurat Method for Generating Random Variables" (2000)
+// The tables are built at compile time so they sit in flash. One 32 bit number picks the
+// layer from the low bits and a 24 bit position from the rest, most draws land inside the
+// layer's box and only need a compare and a multiply. The wedges and the tail need floats.
+// -------------------------------------------------------
+
+// No constexpr maths in the standard library, these only have to be good enough for the tables
+static constexpr f64 LN2 = 0.6931471805599453;
+
+static constexpr f64 constexpr_exp( f64 x )
+{
+	i32 k = static_cast<i32>( x / LN2 + ( x < 0 ? -0.5 : 0.5 ) );
+	f64 r = x - k * LN2;
+	f64 term = 1.0;
+	f64 sum = 1.0;
+
+	for ( i32 i = 1; i < 24; ++i )
+	{
+		term *= r / i;
+		sum += term;
+	}
+
+	for ( ; k > 0; --k )
+		sum *= 2.0;
+
+	for ( ; k < 0; ++k )
+		sum *= 0.5;
+
+	return sum;
+}
+
+static constexpr f64 constexpr_log( f64 x )
+{
+	i32 e = 0;
+
+	while ( x >= 1.0 )
+	{
+		x *= 0.5;
+		e += 1;
+	}
+
+	while ( x < 0.5 )
+	{
+		x *= 2.0;
+		e -= 1;
+	}
+
+	// log( x ) = 2 atanh( ( x - 1 ) / ( x + 1 ) )
+	f64 y = ( x - 1.0 ) / ( x + 1.0 );
+	f64 y2 = y * y;
+	f64 term = y;
+	f64 sum = 0.0;
+
+	for ( i32 i = 1; i < 80; i += 2 )
+	{
+		sum += term / i;
+		term *= y2;
+	}
+
+	return 2.0 * sum + e * LN2;
+}
+
+static constexpr f64 constexpr_sqrt( f64 x )
+{
+	f64 r = x > 1.0 ? x : 1.0;
+
+	for ( i32 i = 0; i < 64; ++i )
+		r = 0.5 * ( r + x / r );
+
+	return r;
+}
+
+static constexpr f64 ZIGGURAT_SCALE = 16777216.0;				// 2^24, the position within a layer
+
+template <u32 N>
+struct ZigguratTable
+{
+	u32 k[ N ];										// accept below this without any maths
+	u32 w[ N ];										// layer width in Q16, position * w >> 24 is the number
+	f32 f[ N ];										// density at the layer's edge, for the wedges
+};
+
+static constexpr u32 NORMAL_LAYERS = 128;
+static constexpr f64 NORMAL_R = 3.442619855899;
+static constexpr f64 NORMAL_V = 9.91256303526217e-3;
+
+static constexpr u32 EXPONENTIAL_LAYERS = 256;
+static constexpr f64 EXPONENTIAL_R = 7.697117470131487;
+static constexpr f64 EXPONENTIAL_V = 3.949659822581572e-3;
+
+static constexpr ZigguratTable<NORMAL_LAYERS> make_normal_table()
+{
+	ZigguratTable<NORMAL_LAYERS> table = {};
+	f64 dn = NORMAL_R;
+	f64 tn = dn;
+	f64 q = NORMAL_V / constexpr_exp( -0.5 * dn * dn );
+
+	table.k[ 0 ] = static_cast<u32>( ( dn / q ) * ZIGGURAT_SCALE );
+	table.k[ 1 ] = 0;
+	table.w[ 0 ] = static_cast<u32>( q * 65536.0 );
+	table.w[ NORMAL_LAYERS - 1 ] = static_cast<u32>( dn * 65536.0 );
+	table.f[ 0 ] = 1.0f;
+	table.f[ NORMAL_LAYERS - 1 ] = static_cast<f32>( constexpr_exp( -0.5 * dn * dn ) );
+
+	for ( i32 i = NORMAL_LAYERS - 2; i >= 1; --i )
+	{
+		dn = constexpr_sqrt( -2.0 * constexpr_log( NORMAL_V / dn + constexpr_exp( -0.5 * dn * dn ) ) );
+		table.k[ i + 1 ] = static_cast<u32>( ( dn / tn ) * ZIGGURAT_SCALE );
+		tn = dn;
+		table.f[ i ] = static_cast<f32>( constexpr_exp( -0.5 * dn * dn ) );
+		table.w[ i ] = static_cast<u32>( dn * 65536.0 );
+	}
+
+	return table;
+}
+
+static constexpr ZigguratTable<EXPONENTIAL_LAYERS> make_exponential_table()
+{
+	ZigguratTable<EXPONENTIAL_LAYERS> table = {};
+	f64 de = EXPONENTIAL_R;
+	f64 te = de;
+	f64 q = EXPONENTIAL_V / constexpr_exp( -de );
+
+	table.k[ 0 ] = static_cast<u32>( ( de / q ) * ZIGGURAT_SCALE );
+	table.k[ 1 ] = 0;
+	table.w[ 0 ] = static_cast<u32>( q * 65536.0 );
+	table.w[ EXPONENTIAL_LAYERS - 1 ] = static_cast<u32>( de * 65536.0 );
+	table.f[ 0 ] = 1.0f;
+	table.f[ EXPONENTIAL_LAYERS - 1 ] = static_cast<f32>( constexpr_exp( -de ) );
+
+	for ( i32 i = EXPONENTIAL_LAYERS - 2; i >= 1; --i )
+	{
+		de = -constexpr_log( EXPONENTIAL_V / de + constexpr_exp( -de ) );
+		table.k[ i + 1 ] = static_cast<u32>( ( de / te ) * ZIGGURAT_SCALE );
+		te = de;
+		table.f[ i ] = static_cast<f32>( constexpr_exp( -de ) );
+		table.w[ i ] = static_cast<u32>( de * 65536.0 );
+	}
+
+	return table;
+}
+
+static constexpr ZigguratTable<NORMAL_LAYERS> normalTable = make_normal_table();
+static constexpr ZigguratTable<EXPONENTIAL_LAYERS> exponentialTable = make_exponential_table();
+
+static_assert( normalTable.w[ NORMAL_LAYERS - 1 ] == static_cast<u32>( NORMAL_R * 65536.0 ) );
+static_assert( normalTable.k[ NORMAL_LAYERS - 1 ] > normalTable.k[ 2 ], "The top layers are the narrowest" );
+
+static inline u32 ziggurat_value( u32 position, u32 width )
+{
+	return static_cast<u32>( ( static_cast<u64>( position ) * width ) >> 24 );
+}
+
+template <typename Engine>
+[[nodiscard]] i32 Random<Engine>::normal_q16()
+{
+	while ( true )
+	{
+		u32 u = engine.next32();
+		u32 layer = u & ( NORMAL_LAYERS - 1 );
+		bool negative = u & NORMAL_LAYERS;
+		u32 position = u >> 8;
+
+		i32 x = static_cast<i32>( ziggurat_value( position, normalTable.w[ layer ] ) );
+
+		if ( position < normalTable.k[ layer ] )
+			return negative ? -x : x;
+
+		f32 xf;
+
+		if ( layer == 0 )
+		{
+			// The tail past r
+			f32 tail;
+			f32 y;
+
+			do
+			{
+				tail = -logf( 1.0f - random_f32_0_1() ) / static_cast<f32>( NORMAL_R );
+				y = -logf( 1.0f - random_f32_0_1() );
+			}
+			while ( y + y < tail * tail );
+
+			xf = static_cast<f32>( NORMAL_R ) + tail;
+		}
+		else
+		{
+			// The wedge between this layer's box and the curve
+			xf = x * ( 1.0f / 65536.0f );
+
+			f32 f0 = normalTable.f[ layer - 1 ];
+			f32 f1 = normalTable.f[ layer ];
+
+			if ( f1 + random_f32_0_1() * ( f0 - f1 ) >= expf( -0.5f * xf * xf ) )
+				continue;
+		}
+
+		i32 q16 = static_cast<i32>( xf * 65536.0f );
+
+		return negative ? -q16 : q16;
+	}
+}
+
+template <typename Engine>
+[[nodiscard]] i32 Random<Engine>::exponential_q16()
+{
+	while ( true )
+	{
+		u32 u = engine.next32();
+		u32 layer = u & ( EXPONENTIAL_LAYERS - 1 );
+		u32 position = u >> 8;
+
+		i32 x = static_cast<i32>( ziggurat_value( position, exponentialTable.w[ layer ] ) );
+
+		if ( position < exponentialTable.k[ layer ] )
+			return x;
+
+		if ( layer == 0 )
+		{
+			// The tail is memoryless, r plus another exponential
+			return static_cast<i32>( ( static_cast<f32>( EXPONENTIAL_R ) - logf( 1.0f - random_f32_0_1() ) ) * 65536.0f );
+		}
+
+		f32 xf = x * ( 1.0f / 65536.0f );
+		f32 f0 = exponentialTable.f[ layer - 1 ];
+		f32 f1 = exponentialTable.f[ layer ];
+
+		if ( f1 + random_f32_0_1() * ( f0 - f1 ) < expf( -xf ) )
+			return x;
+	}
+}
+
+template struct Random<Xoshiro256starstar>;
+template struct Random<Xoshiro256plus>;
+template struct Random<Xoshiro128starstar>;
+template struct Random<Xoshiro128plus>;
+template struct Random<Pcg32>;
+template struct Random<RandomPool>;
+
+// -------------------------------------------------------
+
+void RandomPool::init( RandomStream *source, const RandomEngine &fallback )
+{
+	words.init();
+
+	this->source = source;
+	this->fallback = fallback;
+
+	paused = 0;
+	filling = 0;
+	hits = 0;
+	misses = 0;
+}
+
+// Producer side only
+u32 RandomPool::refill( u32 count )
+{
+	u32 added = 0;
+	u32 block[ REFILL_BLOCK ];
+
+	// Either this sees paused or pause() sees filling
+	filling = 1;
+	spsc_barrier();
+
+	while ( !paused && added < count && !words.full() )
+	{
+		u32 blockSize = count - added < REFILL_BLOCK ? count - added : REFILL_BLOCK;
+		u32 space = SIZE - ( words.head - words.tail );
+
+		if ( blockSize > space )
+			blockSize = space;
+
+		source->fill( block, blockSize );
+
+		for ( u32 i = 0; i < blockSize; ++i )
+		{
+			words.push( block[ i ] );
+		}
+
+		added += blockSize;
+	}
+
+	spsc_barrier();
+	filling = 0;
+
+	return added;
+}
+
+// Reader side only
+u32 RandomPool::next32()
+{
+	u32 word;
+
+	if ( words.pop( &word ) )
+	{
+		hits += 1;
+		return word;
+	}
+
+	misses += 1;
+
+	return fallback.next32();
+}
+
+void RandomPool::seed( Splitmix64 *splitmix )
+{
+	fallback.seed( splitmix );
+}
+
+void RandomPool::pause()
+{
+	paused = 1;
+	spsc_barrier();
+
+	// At most the block it's on
+	while ( filling )
+	{
+	}
+
+	spsc_barrier();
+}
+
+void RandomPool::resume()
+{
+	spsc_barrier();
+	paused = 0;
+}
+
+void RandomPool::flush()
+{
+	u32 word;
+
+	while ( words.pop( &word ) )
+	{
+	}
+}
+
+// -------------------------------------------------------
+
+static RandomEngine master;
+static RandomStream streams[ static_cast<i32>( RANDOM_STREAM::COUNT ) ];
+static RandomStream &defaultRandom = streams[ static_cast<i32>( RANDOM_STREAM::CORE0 ) ];
+static PooledRandom pool;
+
+
+// Each stream starts a long jump on from the last, the master is left untouched
+static void random_derive_streams()
+{
+	RandomEngine engine = master;
+
+	// The counter key comes from a copy so the streams are the same as without it
+	RandomEngine keyEngine = master;
+	counterKey = keyEngine.next64();
+
+	for ( RandomStream &stream : streams )
+	{
+		engine.long_jump();
+		stream.engine = engine;
+	}
+
+	// The pool's fallback is one more long jump on
+	engine.long_jump();
+	pool.engine.source = random_stream( RANDOM_STREAM::POOL );
+	pool.engine.fallback = engine;
+}
+
+[[nodiscard]] RandomStream *random_stream( RANDOM_STREAM stream )
+{
+	return &streams[ static_cast<i32>( stream ) ];
+}
+
+[[nodiscard]] PooledRandom *random_pool()
+{
+	return &pool;
+}
+
+u32 random_pool_refill( u32 count )
+{
+	return pool.engine.refill( count );
+}
+
+void random_fill( u32 *out, u32 count )
+{
+	defaultRandom.fill( out, count );
+}
+
+void random_set_seed( u64 seed )
+{
+	Splitmix64 splitmix { seed };
+
+	pool.engine.pause();
+
+	master.seed( &splitmix );
+
+	random_derive_streams();
+
+	pool.engine.flush();
+	pool.engine.resume();
+}
+
+void random_set_seed( const u64 seed[ RANDOM_SEED_WORDS ] )
+{
+	pool.engine.pause();
+
+	master.set_state( seed );
+
+	random_derive_streams();
+
+	pool.engine.flush();
+	pool.engine.resume();
+}
+
+void random_get_seed( u64 seed[ RANDOM_SEED_WORDS ] )
+{
+	master.get_state( seed );
+}
+
+void random_set_state( const RandomState &state )
+{
+	const u64 *words = state.words;
+
+	pool.engine.pause();
+
+	for ( RandomStream &stream : streams )
+	{
+		stream.engine.set_state( words );
+		words += RandomEngine::STATE_WORDS;
+	}
+
+	pool.engine.fallback.set_state( words );
+	words += RandomEngine::STATE_WORDS;
+
+	counterKey = *words;
+
+	pool.engine.flush();
+	pool.engine.resume();
+}
+
+void random_get_state( RandomState *state )
+{
+	u64 *words = state->words;
+
+	// The pool's stream is moving otherwise
+	pool.engine.pause();
+
+	for ( RandomStream &stream : streams )
+	{
+		stream.engine.get_state( words );
+		words += RandomEngine::STATE_WORDS;
+	}
+
+	pool.engine.fallback.get_state( words );
+	words += RandomEngine::STATE_WORDS;
+
+	*words = counterKey;
+
+	pool.engine.resume();
+}
+
+void random_set_state( RANDOM_STREAM stream, const u64 state[ RandomEngine::STATE_WORDS ] )
+{
+	RandomStream *random = random_stream( stream );
+
+	if ( random != pool.engine.source )
+	{
+		random->engine.set_state( state );
+		return;
+	}
+
+	pool.engine.pause();
+	random->engine.set_state( state );
+	pool.engine.flush();
+	pool.engine.resume();
+}
+
+void random_get_state( RANDOM_STREAM stream, u64 state[ RandomEngine::STATE_WORDS ] )
+{
+	RandomStream *random = random_stream( stream );
+
+	if ( random != pool.engine.source )
+	{
+		random->engine.get_state( state );
+		return;
+	}
+
+	pool.engine.pause();
+	random->engine.get_state( state );
+	pool.engine.resume();
+}
+
+// -------------------------------------------------------
+
+[[nodiscard]] u32 irandom( u32 max ) { return defaultRandom.irandom( max ); }
+[[nodiscard]] u32 irandom_range( u32 min, u32 max ) { return defaultRandom.irandom_range( min, max ); }
+[[nodiscard]] i32 irandom( i32 max ) { return defaultRandom.irandom( max ); }
+[[nodiscard]] i32 irandom_range( i32 min, i32 max ) { return defaultRandom.irandom_range( min, max ); }
+[[nodiscard]] i64 irandom( i64 max ) { return defaultRandom.irandom( max ); }
+[[nodiscard]] i64 irandom_range( i64 min, i64 max ) { return defaultRandom.irandom_range( min, max ); }
+[[nodiscard]] u64 irandom( u64 max ) { return defaultRandom.irandom( max ); }
+[[nodiscard]] u64 irandom_range( u64 min, u64 max ) { return defaultRandom.irandom_range( min, max ); }
+[[nodiscard]] f32 random( f32 max ) { return defaultRandom.random( max ); }
+[[nodiscard]] f32 random_range( f32 min, f32 max ) { return defaultRandom.random_range( min, max ); }
+[[nodiscard]] f32 random_f32_0_1() { return defaultRandom.random_f32_0_1(); }
+[[nodiscard]] f64 random_f64_0_1() { return defaultRandom.random_f64_0_1(); }
+[[nodiscard]] bool iproc( i32 chance ) { return defaultRandom.iproc( chance ); }
+[[nodiscard]] bool iproc( i64 chance ) { return defaultRandom.iproc( chance ); }
+[[nodiscard]] bool iproc( u64 chance ) { return defaultRandom.iproc( chance ); }
+[[nodiscard]] bool proc( f32 chance ) { return defaultRandom.proc( chance ); }
+[[nodiscard]] bool proc( Chance chance ) { return defaultRandom.proc( chance ); }
+[[nodiscard]] u64 random_subset( u32 n, u32 k ) { return defaultRandom.random_subset( n, k ); }
+void sample_k_of_n( u8 *out, u32 k, u32 n ) { defaultRandom.sample_k_of_n( out, k, n ); }
+[[nodiscard]] i32 random_normal_q16() { return defaultRandom.normal_q16(); }
+[[nodiscard]] i32 random_exponential_q16() { return defaultRandom.exponential_q16(); }
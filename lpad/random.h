@@ -2,10 +2,399 @@
 #pragma once
 
 #include "types.h"
+#include "spsc_ring.h"
+
+// -------------------------------------------------------
+// Engines, all give next32() and next64() whatever their native width is
+// -------------------------------------------------------
+
+struct Splitmix64
+{
+	u64 state;
+
+	u64 next();
+
+	// The output step on its own, a good 64 bit hash
+	static u64 mix( u64 z );
+};
+
+struct Xoshiro256starstar
+{
+	static constexpr i32 STATE_WORDS = 4;			// u64s in get_state/set_state
+
+	u64 state[ 4 ];
+
+	u64 next();
+	u32 next32() { return static_cast<u32>( next() >> 32 ); }
+	u64 next64() { return next(); }
+
+	void seed( Splitmix64 *splitmix );
+	void set_state( const u64 words[ STATE_WORDS ] );
+	void get_state( u64 words[ STATE_WORDS ] );
+	void jump();
+	void long_jump();
+};
+
+struct Xoshiro256plus
+{
+	static constexpr i32 STATE_WORDS = 4;
+
+	u64 state[ 4 ];
+
+	u64 next();
+	u32 next32() { return static_cast<u32>( next() >> 32 ); }		// the low bits are the weak ones
+	u64 next64() { return next(); }
+
+	void seed( Splitmix64 *splitmix );
+	void set_state( const u64 words[ STATE_WORDS ] );
+	void get_state( u64 words[ STATE_WORDS ] );
+	void jump();
+	void long_jump();
+};
+
+// 32 bit native, no 64 bit shifts or rotates for the m0+ to split up
+struct Xoshiro128starstar
+{
+	static constexpr i32 STATE_WORDS = 2;
+
+	u32 state[ 4 ];
+
+	u32 next();
+	u32 next32() { return next(); }
+	u64 next64()
+	{
+		// Two statements, the order of the operands of | isn't sequenced
+		u64 high = next();
+		u64 low = next();
+		return ( high << 32 ) | low;
+	}
+
+	void seed( Splitmix64 *splitmix );
+	void set_state( const u64 words[ STATE_WORDS ] );
+	void get_state( u64 words[ STATE_WORDS ] );
+	void jump();
+	void long_jump();
+};
+
+struct Xoshiro128plus
+{
+	static constexpr i32 STATE_WORDS = 2;
+
+	u32 state[ 4 ];
+
+	u32 next();
+	u32 next32() { return next(); }
+	u64 next64()
+	{
+		u64 high = next();
+		u64 low = next();
+		return ( high << 32 ) | low;
+	}
+
+	void seed( Splitmix64 *splitmix );
+	void set_state( const u64 words[ STATE_WORDS ] );
+	void get_state( u64 words[ STATE_WORDS ] );
+	void jump();
+	void long_jump();
+};
+
+// 32 bit output from 64 bit state, one 64 bit multiply per number
+struct Pcg32
+{
+	static constexpr i32 STATE_WORDS = 2;
+
+	u64 state;
+	u64 increment;									// selects the stream, always odd
+
+	u32 next();
+	u32 next32() { return next(); }
+	u64 next64()
+	{
+		u64 high = next();
+		u64 low = next();
+		return ( high << 32 ) | low;
+	}
+
+	void seed( Splitmix64 *splitmix );
+	void set_state( const u64 words[ STATE_WORDS ] );
+	void get_state( u64 words[ STATE_WORDS ] );
+
+	// Same as calling next() delta times, in log2( delta ) steps
+	void advance( u64 delta );
+
+	// Nearby increments give correlated streams, so these hash the increment into an unrelated
+	// stream and move the state on by 2^32 (jump) or 2^48 (long_jump) as well
+	void jump();
+	void long_jump();
+};
+
+// -------------------------------------------------------
+// Chances as raw 32 bit thresholds, build them at compile time so a proc is one compare
+// -------------------------------------------------------
+
+struct Chance
+{
+	u64 threshold;									// out of 2^32, 2^32 always procs
+};
+
+// 0-100 percent to a threshold
+[[nodiscard]] constexpr Chance chance_percent( f64 percent )
+{
+	if ( percent <= 0 )
+		return { 0 };
+
+	if ( percent >= 100 )
+		return { UINT64_C( 1 ) << 32 };
+
+	return { static_cast<u64>( percent * 4294967296.0 / 100.0 + 0.5 ) };
+}
+
+// Vose's alias table, one column per outcome. A column keeps its own outcome below its
+// threshold and gives its alias above it, so a weighted pick costs two numbers and a compare.
+template <u32 N>
+struct AliasTable
+{
+	static_assert( N > 0 && N <= 256, "Aliases are u8" );
+
+	u32 keep[ N ];									// out of 2^32
+	u8 alias[ N ];
+};
+
+template <u32 N>
+[[nodiscard]] constexpr AliasTable<N> make_alias_table( const f64 ( &weights )[ N ] )
+{
+	AliasTable<N> table = {};
+	f64 scaled[ N ] = {};
+	u32 small[ N ] = {};
+	u32 large[ N ] = {};
+	u32 smallCount = 0;
+	u32 largeCount = 0;
+	f64 total = 0;
+
+	for ( u32 i = 0; i < N; ++i )
+		total += weights[ i ];
+
+	for ( u32 i = 0; i < N; ++i )
+	{
+		scaled[ i ] = weights[ i ] * N / total;
+
+		if ( scaled[ i ] < 1.0 )
+			small[ smallCount++ ] = i;
+		else
+			large[ largeCount++ ] = i;
+	}
+
+	while ( smallCount > 0 && largeCount > 0 )
+	{
+		u32 less = small[ --smallCount ];
+		u32 more = large[ --largeCount ];
+
+		table.keep[ less ] = static_cast<u32>( scaled[ less ] * 4294967296.0 );
+		table.alias[ less ] = static_cast<u8>( more );
+
+		scaled[ more ] = ( scaled[ more ] + scaled[ less ] ) - 1.0;
+
+		if ( scaled[ more ] < 1.0 )
+			small[ smallCount++ ] = more;
+		else
+			large[ largeCount++ ] = more;
+	}
+
+	// Whatever is left is full, rounding can leave it in either list. Aliasing
+	// itself means the compare doesn't matter.
+	while ( largeCount > 0 )
+	{
+		u32 full = large[ --largeCount ];
+		table.keep[ full ] = UINT32_MAX;
+		table.alias[ full ] = static_cast<u8>( full );
+	}
+
+	while ( smallCount > 0 )
+	{
+		u32 full = small[ --smallCount ];
+		table.keep[ full ] = UINT32_MAX;
+		table.alias[ full ] = static_cast<u8>( full );
+	}
+
+	return table;
+}
+
+// -------------------------------------------------------
+// The number functions on top of any engine, see the free functions below for what each does.
+// Instantiated in random.cpp for each engine above.
+// -------------------------------------------------------
+
+template <typename Engine>
+struct Random
+{
+	Engine engine;
+
+	void set_seed( u64 seed );
+
+	// Raw words straight from the engine in a tight loop
+	void fill( u32 *out, u32 count );
+
+	// Lemire's multiply and shift, a range of 0 means the whole type
+	[[nodiscard]] u32 bounded( u32 range );
+	[[nodiscard]] u64 bounded( u64 range );
+
+	[[nodiscard]] u32 irandom( u32 max );
+	[[nodiscard]] u32 irandom_range( u32 min, u32 max );
+	[[nodiscard]] i32 irandom( i32 max );
+	[[nodiscard]] i32 irandom_range( i32 min, i32 max );
+	[[nodiscard]] i64 irandom( i64 max );
+	[[nodiscard]] i64 irandom_range( i64 min, i64 max );
+	[[nodiscard]] u64 irandom( u64 max );
+	[[nodiscard]] u64 irandom_range( u64 min, u64 max );
+	[[nodiscard]] f32 random( f32 max );
+	[[nodiscard]] f32 random_range( f32 min, f32 max );
+	[[nodiscard]] f32 random_f32_0_1();
+	[[nodiscard]] f64 random_f64_0_1();
+	[[nodiscard]] bool iproc( i32 chance );
+	[[nodiscard]] bool iproc( i64 chance );
+	[[nodiscard]] bool iproc( u64 chance );
+	[[nodiscard]] bool proc( f32 chance );
+	[[nodiscard]] bool proc( Chance chance );
+
+	// Ziggurat, Q16 fixed point. Integer only apart from the rare wedge and tail draws.
+	[[nodiscard]] i32 normal_q16();					// mean 0, standard deviation 1
+	[[nodiscard]] i32 exponential_q16();			// rate 1
+
+	// k of n (at most 64) distinct indices as a bitmask, Floyd's algorithm so only k numbers are drawn
+	[[nodiscard]] u64 random_subset( u32 n, u32 k );
+
+	// k of n (at most 64) distinct indices in a random order
+	void sample_k_of_n( u8 *out, u32 k, u32 n );
+
+	// Fisher-Yates
+	template <typename T>
+	void shuffle( T *items, u32 count )
+	{
+		for ( u32 i = count; i > 1; --i )
+		{
+			u32 j = bounded( i );
+			T temp = items[ i - 1 ];
+			items[ i - 1 ] = items[ j ];
+			items[ j ] = temp;
+		}
+	}
+
+	// Weighted pick, returns the outcome index
+	template <u32 N>
+	[[nodiscard]] u32 choose( const AliasTable<N> &table )
+	{
+		u32 column = bounded( N );
+
+		return engine.next32() < table.keep[ column ] ? column : table.alias[ column ];
+	}
+};
+
+// Engine behind the free functions, 32 bit for the m0+. Not the + variant, its low bits are
+// weak and the ziggurat picks its layer from them.
+using RandomEngine = Xoshiro128starstar;
+using RandomStream = Random<RandomEngine>;
+
+// Independent streams long jumped from the one master seed. Each is only ever used by one
+// core so nothing needs a lock, and each gives the same numbers for a seed whatever the others do.
+// A stream can jump() itself to hand out sub streams.
+enum class RANDOM_STREAM : u8
+{
+	CORE0,											// the free functions
+	CORE1,
+	PHOTON_SMASH,									// level generation, a seed always gives the same levels
+	POOL,											// feeds the pool, core1 only
+
+	COUNT
+};
+
+/// @func random_stream( stream )
+/// @desc Return the stream to call the number functions on
+/// @param	{RANDOM_STREAM}	stream
+/// @return	{RandomStream*}	stream
+[[nodiscard]] RandomStream *random_stream( RANDOM_STREAM stream );
+
+// Words made ahead of time by the producer core so the reader pays one array read per number.
+// An empty pool falls back on an engine the reader owns, misses counts how often. Which
+// numbers come from where depends on timing, so only use it where the order doesn't matter.
+// Random<RandomPool> gives all the number functions on top of it.
+struct RandomPool
+{
+	static constexpr u32 SIZE = 64;
+	static constexpr u32 REFILL_BLOCK = 16;			// words made per fill() call
+
+	SpscRing<u32, SIZE> words;
+	RandomStream *source;							// producer side
+	RandomEngine fallback;							// reader side
+	volatile u32 paused;							// set by the reader, the producer makes nothing
+	volatile u32 filling;							// set by the producer while it's in refill()
+	u32 hits;
+	u32 misses;
+
+	void init( RandomStream *source, const RandomEngine &fallback );
+	u32 refill( u32 count );
+	u32 next32();
+
+	// Reader side. Between pause() and resume() the producer is out of refill() and stays
+	// out, so source can be changed and anything made from it before can be flushed.
+	void pause();
+	void resume();
+	void flush();
+
+	u64 next64()
+	{
+		u64 high = next32();
+		u64 low = next32();
+		return ( high << 32 ) | low;
+	}
+	void seed( Splitmix64 *splitmix );
+};
+
+using PooledRandom = Random<RandomPool>;
+
+/// @func random_pool()
+/// @desc Return the pool fed from the POOL stream, read it from core0 only
+/// @return	{PooledRandom*}	pool
+[[nodiscard]] PooledRandom *random_pool();
+
+/// @func random_pool_refill( count )
+/// @desc Top the pool up by upto count words, call it from core1 when idle
+/// @param	{u32}	count
+/// @return	{u32}	words added
+u32 random_pool_refill( u32 count = RandomPool::SIZE );
+
+/// @func random_fill( out, count )
+/// @desc Fill out with count random words
+/// @param	{u32*}	out
+/// @param	{u32}	count
+void random_fill( u32 *out, u32 count );
+
+// The seed is the master engine's state, the one u64 version expands it with splitmix64.
+// Seeding the master re-derives every stream from it, they all start over.
+// random_get_seed gives that seed back, not where the streams are up to.
+// Seeding and restoring hold the pool's producer off and flush the pool, from core0 only.
+constexpr i32 RANDOM_SEED_WORDS = RandomEngine::STATE_WORDS;
 
 void random_set_seed( u64 seed );
-void random_set_seed( const u64 seed[ 9 ] );
-void random_get_state( u64 state[ 9 ] );
+void random_set_seed( const u64 seed[ RANDOM_SEED_WORDS ] );
+void random_get_seed( u64 seed[ RANDOM_SEED_WORDS ] );
+
+// Every stream, the pool's fallback and the counter key. A struct so the size is checked, an
+// array of the old 9 words can't be passed in.
+struct RandomState
+{
+	static constexpr i32 WORDS = RandomEngine::STATE_WORDS * ( static_cast<i32>( RANDOM_STREAM::COUNT ) + 1 ) + 1;
+
+	u64 words[ WORDS ];
+};
+
+// Snapshot and restore where the streams are up to, restoring carries on with the same numbers.
+// Words already in the pool are dropped, the pool only gives words made after the restore.
+void random_set_state( const RandomState &state );
+void random_get_state( RandomState *state );
+
+// The same for one stream, the others are untouched
+void random_set_state( RANDOM_STREAM stream, const u64 state[ RandomEngine::STATE_WORDS ] );
+void random_get_state( RANDOM_STREAM stream, u64 state[ RandomEngine::STATE_WORDS ] );
 
 /// @func irandom( max )
 /// @desc Return a random number ranged from 0 to max (inclusive)
@@ -104,4 +493,60 @@ void random_get_state( u64 state[ 9 ] );
 /// @desc Percent chance to proc something (inclusive)
 /// @param	{f32}	chance : upto 5 decimal places max (0-100)
 /// @return	{bool}	proc
-[[nodiscard]] bool proc( f32 chance );
\ No newline at end of file
+[[nodiscard]] bool proc( f32 chance );
+
+/// @func proc( chance )
+/// @desc Chance to proc something, make the chance with chance_percent at compile time
+/// @param	{Chance}	chance
+/// @return	{bool}	proc
+[[nodiscard]] bool proc( Chance chance );
+
+/// @func random_subset( n, k )
+/// @desc Return k of n distinct indices as a bitmask
+/// @param	{u32}	n (upto 64)
+/// @param	{u32}	k (upto n)
+/// @return	{u64}	bit per chosen index
+[[nodiscard]] u64 random_subset( u32 n, u32 k );
+
+/// @func sample_k_of_n( out, k, n )
+/// @desc Write k of n distinct indices to out in a random order
+/// @param	{u8*}	out (k long)
+/// @param	{u32}	k (upto n)
+/// @param	{u32}	n (upto 64)
+void sample_k_of_n( u8 *out, u32 k, u32 n );
+
+/// @func shuffle( items, count )
+/// @desc Shuffle items in place
+/// @param	{T*}	items
+/// @param	{u32}	count
+template <typename T>
+void shuffle( T *items, u32 count )
+{
+	random_stream( RANDOM_STREAM::CORE0 )->shuffle( items, count );
+}
+
+/// @func random_at( stream, index )
+/// @desc Counter based random number, the same stream and index always give the same number
+///       for a seed. Nothing is stepped so any pad or frame can get its number in any order.
+/// @param	{u64}	stream : any id, e.g. one per effect
+/// @param	{u64}	index : e.g. ( frame << 8 ) | pad
+/// @return	{u64}	random_number
+[[nodiscard]] u64 random_at( u64 stream, u64 index );
+
+/// @func irandom_at( stream, index, max )
+/// @desc Counter based random number ranged from 0 to max (inclusive)
+/// @param	{u64}	stream
+/// @param	{u64}	index
+/// @param	{u32}	max (inclusive)
+/// @return	{u32}	random_number
+[[nodiscard]] u32 irandom_at( u64 stream, u64 index, u32 max );
+
+/// @func random_normal_q16()
+/// @desc Return a normally distributed number, mean 0 and standard deviation 1
+/// @return	{i32}	random_number : Q16 fixed point
+[[nodiscard]] i32 random_normal_q16();
+
+/// @func random_exponential_q16()
+/// @desc Return an exponentially distributed number, rate 1 (mean 1)
+/// @return	{i32}	random_number : Q16 fixed point
+[[nodiscard]] i32 random_exponential_q16();
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+// Host only, for running the level generator and solver in bulk off target.
+// Several xoshiro256+ engines side by side with their state as lanes, AVX2 when it's
+// there and plain loops when not. Lane n gives exactly the numbers a scalar Xoshiro256plus
+// seeded the same and jumped n times would, so nothing found here differs on target.
+// tests/test_random_lanes.cpp checks that and measures the throughput.
+
+#ifndef LPAD_HOST
+	#error "random_lanes.h is only for host builds"
+#endif
+
+#include <stdint.h>
+
+#ifdef __AVX2__
+	#include <immintrin.h>
+#endif
+
+#include "types.h"
+#include "random.h"
+
+template <u32 LANES>
+struct Xoshiro256plusLanes
+{
+	static_assert( LANES > 0 && LANES % 4 == 0, "Lanes come in AVX2 registers of 4" );
+
+	alignas( 32 ) u64 state[ 4 ][ LANES ];			// state word, then lane
+
+	// Each lane a jump on from the last, they never overlap
+	void seed( Xoshiro256plus base )
+	{
+		for ( u32 lane = 0; lane < LANES; ++lane )
+		{
+			for ( i32 word = 0; word < 4; ++word )
+				state[ word ][ lane ] = base.state[ word ];
+
+			base.jump();
+		}
+	}
+
+	// One number per lane
+	void next( u64 out[ LANES ] )
+	{
+		#ifdef __AVX2__
+			for ( u32 lane = 0; lane < LANES; lane += 4 )
+			{
+				__m256i s0 = _mm256_load_si256( reinterpret_cast<const __m256i *>( &state[ 0 ][ lane ] ) );
+				__m256i s1 = _mm256_load_si256( reinterpret_cast<const __m256i *>( &state[ 1 ][ lane ] ) );
+				__m256i s2 = _mm256_load_si256( reinterpret_cast<const __m256i *>( &state[ 2 ][ lane ] ) );
+				__m256i s3 = _mm256_load_si256( reinterpret_cast<const __m256i *>( &state[ 3 ][ lane ] ) );
+
+				_mm256_storeu_si256( reinterpret_cast<__m256i *>( &out[ lane ] ), _mm256_add_epi64( s0, s3 ) );
+
+				__m256i t = _mm256_slli_epi64( s1, 17 );
+
+				s2 = _mm256_xor_si256( s2, s0 );
+				s3 = _mm256_xor_si256( s3, s1 );
+				s1 = _mm256_xor_si256( s1, s2 );
+				s0 = _mm256_xor_si256( s0, s3 );
+
+				s2 = _mm256_xor_si256( s2, t );
+
+				s3 = _mm256_or_si256( _mm256_slli_epi64( s3, 45 ), _mm256_srli_epi64( s3, 64 - 45 ) );
+
+				_mm256_store_si256( reinterpret_cast<__m256i *>( &state[ 0 ][ lane ] ), s0 );
+				_mm256_store_si256( reinterpret_cast<__m256i *>( &state[ 1 ][ lane ] ), s1 );
+				_mm256_store_si256( reinterpret_cast<__m256i *>( &state[ 2 ][ lane ] ), s2 );
+				_mm256_store_si256( reinterpret_cast<__m256i *>( &state[ 3 ][ lane ] ), s3 );
+			}
+		#else
+			for ( u32 lane = 0; lane < LANES; ++lane )
+			{
+				u64 s0 = state[ 0 ][ lane ];
+				u64 s1 = state[ 1 ][ lane ];
+				u64 s2 = state[ 2 ][ lane ];
+				u64 s3 = state[ 3 ][ lane ];
+
+				out[ lane ] = s0 + s3;
+
+				u64 t = s1 << 17;
+
+				s2 ^= s0;
+				s3 ^= s1;
+				s1 ^= s2;
+				s0 ^= s3;
+
+				s2 ^= t;
+
+				s3 = ( s3 << 45 ) | ( s3 >> ( 64 - 45 ) );
+
+				state[ 0 ][ lane ] = s0;
+				state[ 1 ][ lane ] = s1;
+				state[ 2 ][ lane ] = s2;
+				state[ 3 ][ lane ] = s3;
+			}
+		#endif
+	}
+
+	// Lane interleaved, out[ step * LANES + lane ]. A partial last step still moves every lane on.
+	void fill( u64 *out, u64 count )
+	{
+		u64 whole = count - count % LANES;
+
+		for ( u64 i = 0; i < whole; i += LANES )
+			next( &out[ i ] );
+
+		if ( whole < count )
+		{
+			u64 step[ LANES ];
+			next( step );
+
+			for ( u64 i = whole; i < count; ++i )
+				out[ i ] = step[ i - whole ];
+		}
+	}
+};
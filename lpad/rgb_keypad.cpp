@@ -1,178 +1,593 @@
+#include <stdint.h>
 #include <string.h>
-#include <math.h>
-
-#include "pico/stdlib.h"
-#include "hardware/i2c.h"
-#include "hardware/spi.h"
 
 #include "rgb_keypad.h"
 
-enum PIN
+// x^(1/5) by newton's method, constexpr friendly
+static constexpr f64 fifth_root( f64 x )
+{
+	if ( x <= 0.0 )
+		return 0.0;
+
+	f64 y = 1.0;
+
+	for ( i32 i = 0; i < 64; ++i )
+	{
+		f64 y4 = y * y * y * y;
+		y -= ( y4 * y - x ) / ( 5.0 * y4 );
+	}
+
+	return y;
+}
+
+struct GammaLut
 {
-	SDA		= 4,
-	SCL		= 5,
-	CS		= 17,
-	SCK		= 18,
-	MOSI	= 19
+	u8 brightness[ RGBKeypad::MAX_BRIGHTNESS + 1 ];							// wire brightness for each pad brightness
+	u16 values[ RGBKeypad::MAX_BRIGHTNESS + 1 ][ RGBKeypad::MAX_COLOUR + 1 ];	// 8.8 pwm
 };
 
-void RGBKeypad::init( f32 defaultBrightness )
+// 5 bit linear colour to 8.8 fixed point pwm, gamma 2.2, for each pad brightness. Full white is
+// kept at the current a raw colour of 31 drew (within the 100mA the usb descriptor asks for) by
+// sending the least global brightness that can reach it, which leaves the pwm as near 255 as it
+// gets so the low colours have whole steps to work with. What's left between steps is dithered,
+// unless it's too little to dither without flicker, then it's snapped to the nearest step. A
+// colour that isn't 0 is never snapped to off.
+static constexpr GammaLut make_gamma_lut()
+{
+	GammaLut lut = {};
+
+	for ( i32 brightness = 0; brightness <= RGBKeypad::MAX_BRIGHTNESS; ++brightness )
+	{
+		i32 current = brightness * RGBKeypad::CURRENT_PWM;
+		i32 wire = ( current + RGBKeypad::MAX_PWM - 1 ) / RGBKeypad::MAX_PWM;
+		f64 peak = wire ? current / wire : 0;					// whole, full white isn't dithered over
+
+		lut.brightness[ brightness ] = static_cast<u8>( wire );
+
+		for ( i32 i = 0; i <= RGBKeypad::MAX_COLOUR; ++i )
+		{
+			f64 x = static_cast<f64>( i ) / RGBKeypad::MAX_COLOUR;
+			f64 y = x * x * fifth_root( x );						// x^2.2
+
+			u32 value = static_cast<u32>( y * peak * 256.0 + 0.5 );
+			u32 fraction = value & 0xFF;
+
+			if ( i > 0 && wire && value < 256 )
+				value = 256;
+			else if ( fraction < RGBKeypad::MIN_DITHER_FRACTION )
+				value -= fraction;
+			else if ( fraction > 256 - RGBKeypad::MIN_DITHER_FRACTION )
+				value += 256 - fraction;
+
+			lut.values[ brightness ][ i ] = static_cast<u16>( value );
+		}
+	}
+
+	return lut;
+}
+
+static constexpr GammaLut gammaLut = make_gamma_lut();
+
+static constexpr bool gamma_lut_sane()
+{
+	for ( i32 brightness = 0; brightness <= RGBKeypad::MAX_BRIGHTNESS; ++brightness )
+	{
+		u32 fullWhite = gammaLut.brightness[ brightness ] * ( gammaLut.values[ brightness ][ RGBKeypad::MAX_COLOUR ] >> 8 );
+
+		if ( fullWhite > static_cast<u32>( brightness * RGBKeypad::CURRENT_PWM ) || gammaLut.values[ brightness ][ 0 ] != 0 )
+			return false;
+
+		for ( i32 i = 1; i <= RGBKeypad::MAX_COLOUR; ++i )
+		{
+			u32 fraction = gammaLut.values[ brightness ][ i ] & 0xFF;
+
+			if ( gammaLut.values[ brightness ][ i ] < gammaLut.values[ brightness ][ i - 1 ] )
+				return false;
+
+			if ( fraction && ( fraction < RGBKeypad::MIN_DITHER_FRACTION || fraction > 256 - RGBKeypad::MIN_DITHER_FRACTION ) )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static_assert( gammaLut.brightness[ RGBKeypad::MAX_BRIGHTNESS ] == 4 && gammaLut.values[ RGBKeypad::MAX_BRIGHTNESS ][ RGBKeypad::MAX_COLOUR ] == 240 * 256 );
+static_assert( gamma_lut_sane(), "Full white over its old current, a colour out of order or a fraction that would flicker" );
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::init( f32 defaultBrightness, u32 i2cSpeed, i32 expanderInterruptPin )
 {
 	memset( buffer, 0, sizeof( buffer ) );
+	memset( frontBuffer, 0, sizeof( frontBuffer ) );
 
-	ledData = buffer + 4;
+	ledData = buffer + START_FRAME_SIZE;
 
 	set_brightness( defaultBrightness );
 
-	i2c_init( i2c0, 400000 );
+	i2cReads = 0;
+	i2cErrors = 0;
+	buttonStates = 0;
+	pointersSet = 0;
 
-	gpio_set_function( PIN::SDA, GPIO_FUNC_I2C );
-	gpio_pull_up( PIN::SDA );
+	bus.init( i2cSpeed, expanderInterruptPin );
 
-	gpio_set_function( PIN::SCL, GPIO_FUNC_I2C );
-	gpio_pull_up( PIN::SCL );
+	dirtyPads = ALL_PADS;
+	framesSent = 0;
+	framesSkipped = 0;
 
-	spi_init( spi0, 4 * 1024 * 1024 );
-	gpio_set_function( PIN::CS, GPIO_FUNC_SIO );
-	gpio_set_dir( PIN::CS, GPIO_OUT );
-	gpio_put( PIN::CS, 1 );
-	gpio_set_function( PIN::SCK, GPIO_FUNC_SPI );
-	gpio_set_function( PIN::MOSI, GPIO_FUNC_SPI );
+	memset( lastFrame, 0, sizeof( lastFrame ) );
+	memset( ditherError, 0, sizeof( ditherError ) );
+	ditherPads = 0;
+	lastRenderTime = 0;
+	renderCycles = 0;
+	rendersOverBudget = 0;
+	gammaOutput = true;
 
 	update();
 }
 
-void RGBKeypad::update()
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::update()
 {
-	gpio_put( PIN::CS, 0 );
-	spi_write_blocking( spi0, buffer, sizeof( buffer ) );
-	gpio_put( PIN::CS, 1 );
+	while ( is_busy() )
+	{
+	}
+
+	update_async();
+
+	while ( is_busy() )
+	{
+	}
 }
 
-void RGBKeypad::clear()
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+bool RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::update_async()
 {
-	u8 *ptr = ledData;
+	// Still sending the last frame, the back buffer is kept so it goes out next time
+	if ( is_busy() )
+		return false;
+
+	// The set_* functions build on the current state, so copy rather than swap
+	if ( !take_frame( lastFrame ) )
+		return refresh_async();
+
+	render_frame();
+	start_frame();
 
+	return true;
+}
+
+// Copy out the current frame if anything changed since the last one was taken
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+bool RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::take_frame( u8 frame[ FRAME_SIZE ] )
+{
+	// Nothing changed since the last frame, the leds already show it
+	if ( !dirtyPads )
+	{
+		framesSkipped += 1;
+		return false;
+	}
+
+	memcpy( frame, ledData, FRAME_SIZE );
+	dirtyPads = 0;
+
+	return true;
+}
+
+// Send a frame taken with take_frame, can be on a different core to the one building them
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+bool RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::send_frame_async( const u8 frame[ FRAME_SIZE ] )
+{
+	if ( is_busy() )
+		return false;
+
+	memcpy( lastFrame, frame, FRAME_SIZE );
+
+	render_frame();
+	start_frame();
+
+	return true;
+}
+
+// Send the last frame again while pads are being dithered
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+bool RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::refresh_async()
+{
+	if ( !ditherPads || is_busy() || bus.time_us() - lastRenderTime < DITHER_REFRESH_RATE )
+		return false;
+
+	render_frame();
+	start_frame();
+
+	return true;
+}
+
+// lastFrame to wire data in the front buffer, through the gamma table with temporal dithering
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::render_frame()
+{
+	u32 startCycles = bus.cycles_now();
+	u8 *out = frontBuffer + START_FRAME_SIZE;
+
+	lastRenderTime = bus.time_us();
+
+	if ( !gammaOutput )
+	{
+		memcpy( out, lastFrame, FRAME_SIZE );
+		ditherPads = 0;
+	}
+	else
+	{
+		PadMask dithering = 0;
+
+		for ( i32 index = 0; index < NUM_PADS; ++index )
+		{
+			i32 offset = index * 4;
+
+			u16 fractions = 0;
+
+			u8 brightness = lastFrame[ offset ] & 0b00011111;
+			const u16 *levels = gammaLut.values[ brightness ];
+
+			out[ offset ] = 0b11100000 | gammaLut.brightness[ brightness ];
+
+			for ( i32 channel = 1; channel < 4; ++channel )
+			{
+				u8 colour = lastFrame[ offset + channel ];
+				u16 level = levels[ colour < MAX_COLOUR ? colour : MAX_COLOUR ];
+				u16 value = level + ditherError[ offset + channel ];
+
+				out[ offset + channel ] = static_cast<u8>( value >> 8 );
+				ditherError[ offset + channel ] = static_cast<u8>( value );
+
+				fractions |= level;
+			}
+
+			// Only pads that are on and land between two pwm steps need refreshing
+			if ( brightness && ( fractions & 0xFF ) )
+			{
+				dithering |= PadMask( 1 ) << index;
+			}
+		}
+
+		ditherPads = dithering;
+	}
+
+	renderCycles = bus.cycles_since( startCycles );
+
+	if ( renderCycles > RENDER_CYCLE_BUDGET )
+	{
+		rendersOverBudget += 1;
+	}
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::start_frame()
+{
+	framesSent += 1;
+
+	bus.spi_write_async( frontBuffer, BUFFER_SIZE );
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+bool RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::is_busy()
+{
+	return bus.spi_busy();
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::clear()
+{
 	for ( i32 i = 0; i < NUM_PADS; ++i )
 	{
-		*ptr++ = 0b11100000;
-		*ptr++ = 0;
-		*ptr++ = 0;
-		*ptr++ = 0;
+		write_pad( i, 0b11100000, 0, 0, 0 );
 	}
 }
 
-void RGBKeypad::free()
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::free()
 {
 	clear();
 	update();
+
+	bus.free();
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::write_pad( i32 index, u8 r, u8 g, u8 b )
+{
+	u8 *pad = &ledData[ index * 4 ];
+
+	if ( pad[ 1 ] == b && pad[ 2 ] == g && pad[ 3 ] == r )
+		return;
+
+	pad[ 1 ] = b;
+	pad[ 2 ] = g;
+	pad[ 3 ] = r;
+
+	dirtyPads |= PadMask( 1 ) << index;
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::write_pad( i32 index, u8 header, u8 r, u8 g, u8 b )
+{
+	set_pad( index, header | ( b << 8 ) | ( g << 16 ) | ( static_cast<u32>( r ) << 24 ) );
 }
 
-void RGBKeypad::set_brightness( f32 brightness )
+// One word compare and store, no bounds check
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_pad( i32 index, PackedColour colour )
+{
+	u8 *pad = &ledData[ index * 4 ];
+
+	if ( load_packed( pad ) == colour )
+		return;
+
+	store_packed( pad, colour );
+
+	dirtyPads |= PadMask( 1 ) << index;
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+PackedColour RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::get_pad( i32 index )
+{
+	return load_packed( &ledData[ index * 4 ] );
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_brightness( f32 brightness )
 {
 	if ( brightness < 0.0f || brightness > 1.0f )
 		return;
 
+	set_brightness_raw( to_brightness( brightness ) );
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+f32 RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::get_brightness( u8 index )
+{
+	return get_brightness_raw( index ) / 31.f;
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_brightness_raw( u8 brightness )
+{
+	if ( brightness > MAX_BRIGHTNESS )
+		return;
+
+	u8 header = 0b11100000 | brightness;
+
 	for ( i32 i = 0; i < NUM_PADS; ++i )
-		ledData[ i * 4 ] = 0b11100000 | static_cast<u8>( brightness * 31.f );
+	{
+		if ( ledData[ i * 4 ] != header )
+		{
+			ledData[ i * 4 ] = header;
+			dirtyPads |= PadMask( 1 ) << i;
+		}
+	}
 }
 
-f32 RGBKeypad::get_brightness( u8 index )
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+u8 RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::get_brightness_raw( u8 index )
 {
-	return ( ledData[ index * 4 ] & 0b00011111 ) / 31.f;
+	return ledData[ index * 4 ] & 0b00011111;
 }
 
-void RGBKeypad::set_colour( u8 x, u8 y, u8 r, u8 g, u8 b )
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour( u8 x, u8 y, u8 r, u8 g, u8 b )
 {
 	if ( x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT )
 		return;
 
-	i32 offset = ( x + ( y * WIDTH ) ) * 4;
+	// Each keypad's pads are contiguous in the chain
+	i32 keypad = x / KEYPAD_WIDTH;
+	i32 column = x % KEYPAD_WIDTH;
 
-	ledData[ offset + 1 ] = b;
-	ledData[ offset + 2 ] = g;
-	ledData[ offset + 3 ] = r;
+	write_pad( keypad * KEYPAD_PADS + y * KEYPAD_WIDTH + column, r, g, b );
 }
 
-void RGBKeypad::set_colour( u8 r, u8 g, u8 b )
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour( u8 r, u8 g, u8 b )
 {
 	for ( i32 index = 0; index < NUM_PADS; ++index )
 	{
-		i32 offset = index * 4;
-
-		ledData[ offset + 1 ] = b;
-		ledData[ offset + 2 ] = g;
-		ledData[ offset + 3 ] = r;
+		write_pad( index, r, g, b );
 	}
 }
 
-void RGBKeypad::set_colour( u8 index, u8 r, u8 g, u8 b )
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour( u8 index, u8 r, u8 g, u8 b )
 {
 	if ( index < 0 || index >= NUM_PADS )
 		return;
 
-	i32 offset = index * 4;
+	write_pad( index, r, g, b );
+}
 
-	ledData[ offset + 1 ] = b;
-	ledData[ offset + 2 ] = g;
-	ledData[ offset + 3 ] = r;
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour( u8 index, u8 r, u8 g, u8 b, f32 brightness )
+{
+	set_colour_raw( index, r, g, b, to_brightness( brightness ) );
 }
 
-void RGBKeypad::set_colour( u8 index, u8 r, u8 g, u8 b, f32 brightness )
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour( Colour colour )
+{
+	// Each pad keeps its own brightness
+	PackedColour rgb = pack_colour( colour, 0 ) & ~0xFFu;
+
+	for ( i32 index = 0; index < NUM_PADS; ++index )
+	{
+		set_pad( index, ( get_pad( index ) & 0xFF ) | rgb );
+	}
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour( Colour colour, f32 brightness )
+{
+	set_colour_raw( colour, to_brightness( brightness ) );
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour( u8 index, Colour colour )
+{
+	set_colour( index, colour.r, colour.g, colour.b );
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour( u8 index, Colour colour, f32 brightness )
+{
+	set_colour( index, colour.r, colour.g, colour.b, brightness );
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour_raw( u8 index, u8 r, u8 g, u8 b, u8 brightness )
 {
 	if ( index < 0 || index >= NUM_PADS )
 		return;
 
-	i32 offset = index * 4;
-
-	ledData[ offset + 0 ] = 0b11100000 | static_cast<u8>( brightness * 31.f );
-	ledData[ offset + 1 ] = b;
-	ledData[ offset + 2 ] = g;
-	ledData[ offset + 3 ] = r;
+	write_pad( index, 0b11100000 | ( brightness & 0b00011111 ), r, g, b );
 }
 
-void RGBKeypad::set_colour( Colour colour )
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour_raw( Colour colour, u8 brightness )
 {
+	PackedColour packed = pack_colour( colour, brightness );
+
 	for ( i32 index = 0; index < NUM_PADS; ++index )
 	{
-		i32 offset = index * 4;
-
-		ledData[ offset + 1 ] = colour.b;
-		ledData[ offset + 2 ] = colour.g;
-		ledData[ offset + 3 ] = colour.r;
+		set_pad( index, packed );
 	}
 }
 
-void RGBKeypad::set_colour( Colour colour, f32 brightness )
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_colour_raw( u8 index, Colour colour, u8 brightness )
+{
+	set_colour_raw( index, colour.r, colour.g, colour.b, brightness );
+}
+
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_frame( const u8 ( &frame )[ FRAME_SIZE ] )
 {
 	for ( i32 index = 0; index < NUM_PADS; ++index )
 	{
-		i32 offset = index * 4;
-
-		ledData[ offset + 0 ] = 0b11100000 | static_cast<u8>( brightness * 31.f );
-		ledData[ offset + 1 ] = colour.b;
-		ledData[ offset + 2 ] = colour.g;
-		ledData[ offset + 3 ] = colour.r;
+		if ( memcmp( &ledData[ index * 4 ], &frame[ index * 4 ], 4 ) != 0 )
+			dirtyPads |= PadMask( 1 ) << index;
 	}
+
+	memcpy( ledData, frame, FRAME_SIZE );
 }
 
-void RGBKeypad::set_colour( u8 index, Colour colour )
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+void RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::set_frame( const PackedColour ( &frame )[ NUM_PADS ] )
 {
-	set_colour( index, colour.r, colour.g, colour.b );
+	for ( i32 index = 0; index < NUM_PADS; ++index )
+	{
+		set_pad( index, frame[ index ] );
+	}
 }
 
-void RGBKeypad::set_colour( u8 index, Colour colour, f32 brightness )
+// One expander after its read failed, with retries. A nack only needs another go, the bus is
+// only recovered if a slave is holding SDA low or the plain retry failed too. Either can leave
+// the expander mid command, so its pointer is written again before each read. port is the raw
+// inputs (pulled up, pressed reads 0).
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+bool RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::read_expander( i32 keypad, u16 *port )
 {
-	set_colour( index, colour.r, colour.g, colour.b, brightness );
+	u8 address = KEYPAD_ADDRESS + keypad;
+	u8 data[ 2 ];
+
+	for ( i32 attempt = 0; attempt < I2C_RETRIES; ++attempt )
+	{
+		if ( attempt > 0 || bus.i2c_sda_low() )
+			bus.i2c_recover();
+
+		pointersSet &= ~( 1 << keypad );
+
+		i2cReads += 1;
+
+		if ( bus.i2c_write( address, &INPUT_PORT_0, 1 ) && bus.i2c_read_batch( &address, 1, data, 2 ) )
+		{
+			pointersSet |= 1 << keypad;
+			*port = data[ 0 ] | ( data[ 1 ] << 8 );
+			return true;
+		}
+
+		i2cErrors += 1;
+	}
+
+	return false;
 }
 
-u16 RGBKeypad::get_button_states()
+// Reads every expander in the chain into the one mask
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+typename RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::PadMask RGBKeypadChain<KEYPAD_WIDTH, KEYPAD_HEIGHT, KEYPAD_COUNT>::get_button_states()
 {
-	u8 i2c_read_buffer[ 2 ];
-	u8 reg = 0;
+	// Nothing changed since the last read, no need to touch the bus
+	if ( !bus.input_changed() )
+		return buttonStates;
+
+	// The expanders keep their command pointer between reads, once it is on the input ports
+	// reading one is just its 2 bytes, and all of them go in one batch
+	u8 addresses[ COUNT ];
+
+	for ( i32 keypad = 0; keypad < COUNT; ++keypad )
+	{
+		addresses[ keypad ] = KEYPAD_ADDRESS + keypad;
+
+		if ( !( pointersSet & ( 1 << keypad ) ) && bus.i2c_write( addresses[ keypad ], &INPUT_PORT_0, 1 ) )
+			pointersSet |= 1 << keypad;
+	}
+
+	u8 data[ COUNT * 2 ];
+	u32 answered = bus.i2c_read_batch( addresses, COUNT, data, 2 ) & pointersSet;
 
-	i2c_write_blocking( i2c0, KEYPAD_ADDRESS, &reg, 1, true );
-	i2c_read_blocking( i2c0, KEYPAD_ADDRESS, i2c_read_buffer, 2, false );
+	i2cReads += COUNT;
 
-	return ~( ( i2c_read_buffer[ 0 ] ) | ( i2c_read_buffer[ 1 ] << 8 ) );
+	PadMask states = 0;
+	bool failed = false;
+
+	for ( i32 keypad = 0; keypad < COUNT; ++keypad )
+	{
+		PadMask keypadMask = static_cast<PadMask>( KEYPAD_MASK ) << ( keypad * KEYPAD_PADS );
+		u16 port;
+
+		if ( answered & ( 1 << keypad ) )
+		{
+			port = data[ keypad * 2 ] | ( data[ keypad * 2 + 1 ] << 8 );
+		}
+		else
+		{
+			i2cErrors += 1;
+
+			if ( !read_expander( keypad, &port ) )
+			{
+				// Keep the last known state, try again next time
+				states |= buttonStates & keypadMask;
+				failed = true;
+				continue;
+			}
+		}
+
+		states |= static_cast<PadMask>( static_cast<u16>( ~port ) & KEYPAD_MASK ) << ( keypad * KEYPAD_PADS );
+	}
+
+	if ( failed )
+	{
+		bus.input_retry();
+	}
+
+	buttonStates = states;
+
+	return buttonStates;
 }
+
+// Every chain of 4x4 keypads that fits, so any of them links without touching this file
+static_assert( RGBKeypadChain<4, 4, 1>::MAX_COUNT == 4 );
+
+template struct RGBKeypadChain<4, 4, 1>;
+template struct RGBKeypadChain<4, 4, 2>;
+template struct RGBKeypadChain<4, 4, 3>;
+template struct RGBKeypadChain<4, 4, 4>;
+
@@ -1,27 +1,127 @@
 
 #pragma once
 
+#include <type_traits>
+
 #include "types.h"
+#include "packed_colour.h"
+#include "keypad_bus.h"
 
-struct RGBKeypad
+// COUNT keypads of KEYPAD_WIDTH x KEYPAD_HEIGHT pads, tiled left to right. Their leds are
+// daisy chained on the one spi bus and each expander is on the next i2c address.
+template <i32 KEYPAD_WIDTH, i32 KEYPAD_HEIGHT, i32 KEYPAD_COUNT>
+struct RGBKeypadChain
 {
-	static constexpr u8 KEYPAD_ADDRESS = 0x20;
+	static constexpr u8 KEYPAD_ADDRESS = 0x20;						// first expander, the rest follow on
+	static constexpr u8 INPUT_PORT_0 = 0x00;						// tca9555 command, reads give input port 0 then 1
+	static constexpr u32 I2C_FAST_MODE = 400000;
+	static constexpr u32 I2C_FAST_MODE_PLUS = 1000000;				// only if the expander supports it
+	static constexpr i32 I2C_RETRIES = 2;
+	static constexpr i32 NO_INTERRUPT_PIN = KeypadBus::NO_INTERRUPT_PIN;
 	static constexpr f32 DEFAULT_BRIGHTNESS = 0.5f;
-	static constexpr i32 WIDTH = 4;
-	static constexpr i32 HEIGHT = 4;
-	static constexpr i32 NUM_PADS = WIDTH * HEIGHT;
-	static constexpr i32 BUFFER_SIZE = ( NUM_PADS * 4 ) + 8;
+	static constexpr u8 MAX_BRIGHTNESS = 31;						// apa102 5 bit global brightness
+	static constexpr i32 COUNT = KEYPAD_COUNT;
+	static constexpr i32 KEYPAD_PADS = KEYPAD_WIDTH * KEYPAD_HEIGHT;
+	static constexpr i32 WIDTH = KEYPAD_WIDTH * KEYPAD_COUNT;
+	static constexpr i32 HEIGHT = KEYPAD_HEIGHT;
+	static constexpr i32 NUM_PADS = KEYPAD_PADS * KEYPAD_COUNT;
+	static constexpr i32 FRAME_SIZE = NUM_PADS * 4;
+	static constexpr i32 START_FRAME_SIZE = 4;
+	static constexpr i32 END_FRAME_SIZE = ( NUM_PADS + 15 ) / 16 > 4 ? ( NUM_PADS + 15 ) / 16 : 4;	// half a clock per led, at least 32
+	static constexpr i32 BUFFER_SIZE = START_FRAME_SIZE + FRAME_SIZE + END_FRAME_SIZE;
+
+	// The expander has 8 addresses and pad masks are at most 64 bits, 4 keypads of 4x4
+	static constexpr i32 MAX_COUNT = 64 / KEYPAD_PADS < 8 ? 64 / KEYPAD_PADS : 8;
+
+	static_assert( KEYPAD_PADS <= 16, "Each keypad's expander has 16 inputs" );
+	static_assert( KEYPAD_COUNT >= 1 && KEYPAD_COUNT <= MAX_COUNT, "At most 8 expanders and 64 pads in a chain" );
+
+	// Smallest mask with a bit per pad
+	using PadMask = std::conditional_t<NUM_PADS <= 16, u16, std::conditional_t<NUM_PADS <= 32, u32, u64>>;
+
+	static constexpr PadMask ALL_PADS = static_cast<PadMask>( ~PadMask( 0 ) >> ( sizeof( PadMask ) * 8 - NUM_PADS ) );
+	static constexpr u16 KEYPAD_MASK = static_cast<u16>( 0xFFFF >> ( 16 - KEYPAD_PADS ) );
+	static constexpr u8 MAX_COLOUR = 31;							// Colour components are 5 bit
+	static constexpr u8 MAX_PWM = 255;								// top of the gamma output
+	static constexpr u8 CURRENT_PWM = 31;							// full white draws what a raw 31 did, at any brightness
+	static constexpr u16 MIN_DITHER_FRACTION = 64;					// 8.8, any less would be on for under 1 frame in 4 and flicker
+	static constexpr u32 DITHER_REFRESH_RATE = 2000;				// us
+	static constexpr u32 RENDER_CYCLE_BUDGET = 2000;				// cpu cycles to turn a frame into wire data
+
+	// A whole frame already packed in apa102 order (brightness, b, g, r), can be built at compile time
+	struct Frame
+	{
+		alignas( 4 ) u8 data[ FRAME_SIZE ] = {};
+
+		constexpr Frame &set( i32 index, Colour colour, u8 brightness )
+		{
+			data[ index * 4 + 0 ] = 0b11100000 | ( brightness & 0b00011111 );
+			data[ index * 4 + 1 ] = colour.b;
+			data[ index * 4 + 2 ] = colour.g;
+			data[ index * 4 + 3 ] = colour.r;
+			return *this;
+		}
+	};
+
+	// Frame with every pad off, same as clear()
+	static constexpr Frame clear_frame()
+	{
+		Frame frame;
+
+		for ( i32 i = 0; i < NUM_PADS; ++i )
+			frame.set( i, { 0, 0, 0 }, 0 );
+
+		return frame;
+	}
+
+	alignas( 4 ) u8 buffer[ BUFFER_SIZE ];			// back buffer, written by the set_* functions
+	alignas( 4 ) u8 frontBuffer[ BUFFER_SIZE ];		// front buffer, read by the dma while a frame is sent
+	u8 *ledData;									// one PackedColour per pad, 4 byte aligned
 
-	u8 buffer[ BUFFER_SIZE ];
-	u8 *ledData;
+	alignas( 4 ) u8 lastFrame[ FRAME_SIZE ];		// last frame taken, kept to re-dither it
+	u8 ditherError[ FRAME_SIZE ];					// per channel fraction carried to the next frame
+	PadMask ditherPads;							// pads the output alternates on between frames
+	u32 lastRenderTime;								// us
+	u32 renderCycles;								// cost of the last render
+	u32 rendersOverBudget;
+	bool gammaOutput;								// false sends the colours as they are
 
-	void init( f32 defaultBrightness = DEFAULT_BRIGHTNESS );
+	KeypadBus bus;
+
+	PadMask dirtyPads;							// bit per pad changed since the last frame was sent
+	u32 framesSent;
+	u32 framesSkipped;								// updates with nothing changed, no spi traffic
+
+	PadMask buttonStates;							// last states read from the expanders
+	u8 pointersSet;									// bit per expander whose command pointer is on the input ports
+	u32 i2cReads;
+	u32 i2cErrors;
+
+	void init( f32 defaultBrightness = DEFAULT_BRIGHTNESS, u32 i2cSpeed = I2C_FAST_MODE, i32 expanderInterruptPin = NO_INTERRUPT_PIN );
 	void update();
+	bool update_async();
+	bool take_frame( u8 frame[ FRAME_SIZE ] );
+	bool send_frame_async( const u8 frame[ FRAME_SIZE ] );
+	bool refresh_async();
+	void render_frame();
+	bool is_busy();
 	void clear();
 	void free();
+	void start_frame();
+
+	void write_pad( i32 index, u8 r, u8 g, u8 b );
+	void write_pad( i32 index, u8 header, u8 r, u8 g, u8 b );
+
+	// 0-1 to the raw 5 bit brightness, use it for constants so the float maths is done at compile time
+	static constexpr u8 to_brightness( f32 brightness ) { return static_cast<u8>( brightness * MAX_BRIGHTNESS ); }
+
+	// Q8 fraction (0-256) to the raw 5 bit brightness
+	static constexpr u8 q8_to_brightness( u16 fraction ) { return static_cast<u8>( ( fraction * MAX_BRIGHTNESS ) >> 8 ); }
 
 	void set_brightness( f32 brightness );
 	f32 get_brightness( u8 index );
+	void set_brightness_raw( u8 brightness );
+	u8 get_brightness_raw( u8 index );
 
 	void set_colour( u8 r, u8 g, u8 b );
 	void set_colour( u8 x, u8 y, u8 r, u8 g, u8 b );
@@ -32,5 +132,19 @@ struct RGBKeypad
 	void set_colour( u8 index, Colour colour );
 	void set_colour( u8 index, Colour colour, f32 brightness );
 
-	u16 get_button_states();
-};
\ No newline at end of file
+	void set_colour_raw( u8 index, u8 r, u8 g, u8 b, u8 brightness );
+	void set_colour_raw( Colour colour, u8 brightness );
+	void set_colour_raw( u8 index, Colour colour, u8 brightness );
+
+	void set_pad( i32 index, PackedColour colour );
+	PackedColour get_pad( i32 index );
+
+	void set_frame( const u8 ( &frame )[ FRAME_SIZE ] );
+	void set_frame( const PackedColour ( &frame )[ NUM_PADS ] );
+	void set_frame( const Frame &frame ) { set_frame( frame.data ); }
+
+	bool read_expander( i32 keypad, u16 *port );
+	PadMask get_button_states();
+};
+
+using RGBKeypad = RGBKeypadChain<4, 4, 1>;
\ No newline at end of file
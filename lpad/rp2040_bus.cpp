@@ -0,0 +1,275 @@
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+
+#include "rp2040_bus.h"
+#include "cycles.h"
+
+enum PIN
+{
+	SDA		= 4,
+	SCL		= 5,
+	CS		= 17,
+	SCK		= 18,
+	MOSI	= 19
+};
+
+// Only one bus drives the spi dma, the irq needs to find it
+static Rp2040Bus *dmaBus = nullptr;
+
+static void __not_in_flash_func( rp2040_bus_dma_irq )()
+{
+	Rp2040Bus *bus = dmaBus;
+
+	if ( !bus || !dma_channel_get_irq0_status( bus->dmaChannel ) )
+		return;
+
+	dma_channel_acknowledge_irq0( bus->dmaChannel );
+
+	// The last bytes are still shifting out of the fifo, spi_busy() raises CS once they're gone.
+	// Waiting for them here would hold interrupts off for up to 8 bytes (16us).
+	u32 transferTime = time_us_32() - bus->frameStartTime;
+	u32 savedTime = transferTime > bus->frameKickTime ? transferTime - bus->frameKickTime : 0;
+
+	bus->frameCyclesSaved = savedTime * ( clock_get_hz( clk_sys ) / 1000000 );
+	bus->dmaDone = true;
+}
+
+// Only one bus listens to the expander interrupt line
+static Rp2040Bus *interruptBus = nullptr;
+
+static void rp2040_bus_gpio_irq()
+{
+	Rp2040Bus *bus = interruptBus;
+
+	if ( !bus )
+		return;
+
+	if ( gpio_get_irq_event_mask( bus->interruptPin ) & GPIO_IRQ_EDGE_FALL )
+	{
+		gpio_acknowledge_irq( bus->interruptPin, GPIO_IRQ_EDGE_FALL );
+		bus->inputChanged = true;
+	}
+}
+
+static void i2c_bus_init( u32 baudrate )
+{
+	i2c_init( i2c0, baudrate );
+
+	gpio_set_function( PIN::SDA, GPIO_FUNC_I2C );
+	gpio_pull_up( PIN::SDA );
+
+	gpio_set_function( PIN::SCL, GPIO_FUNC_I2C );
+	gpio_pull_up( PIN::SCL );
+}
+
+void Rp2040Bus::init( u32 i2cSpeed, i32 expanderInterruptPin )
+{
+	cycles_init();
+
+	i2cBaudrate = i2cSpeed;
+
+	i2c_bus_init( i2cBaudrate );
+
+	interruptPin = expanderInterruptPin;
+	inputChanged = true;
+
+	if ( interruptPin != NO_INTERRUPT_PIN )
+	{
+		// The expander pulls INT low when an input changes and releases it once the port is read
+		gpio_init( interruptPin );
+		gpio_set_dir( interruptPin, GPIO_IN );
+		gpio_pull_up( interruptPin );
+
+		interruptBus = this;
+
+		gpio_add_raw_irq_handler( interruptPin, rp2040_bus_gpio_irq );
+		gpio_set_irq_enabled( interruptPin, GPIO_IRQ_EDGE_FALL, true );
+		irq_set_enabled( IO_IRQ_BANK0, true );
+	}
+
+	spi_init( spi0, SPI_BAUDRATE );
+	gpio_set_function( PIN::CS, GPIO_FUNC_SIO );
+	gpio_set_dir( PIN::CS, GPIO_OUT );
+	gpio_put( PIN::CS, 1 );
+	gpio_set_function( PIN::SCK, GPIO_FUNC_SPI );
+	gpio_set_function( PIN::MOSI, GPIO_FUNC_SPI );
+
+	busy = false;
+	dmaDone = true;
+	frameStartTime = 0;
+	frameKickTime = 0;
+	frameCyclesSaved = 0;
+
+	dmaChannel = dma_claim_unused_channel( true );
+
+	dma_channel_config config = dma_channel_get_default_config( dmaChannel );
+	channel_config_set_transfer_data_size( &config, DMA_SIZE_8 );
+	channel_config_set_dreq( &config, spi_get_dreq( spi0, true ) );
+	channel_config_set_read_increment( &config, true );
+	channel_config_set_write_increment( &config, false );
+	dma_channel_configure( dmaChannel, &config, &spi_get_hw( spi0 )->dr, nullptr, 0, false );
+
+	dmaBus = this;
+
+	dma_channel_set_irq0_enabled( dmaChannel, true );
+	irq_set_exclusive_handler( DMA_IRQ_0, rp2040_bus_dma_irq );
+	irq_set_enabled( DMA_IRQ_0, true );
+}
+
+void Rp2040Bus::free()
+{
+	irq_set_enabled( DMA_IRQ_0, false );
+	dma_channel_set_irq0_enabled( dmaChannel, false );
+	dma_channel_unclaim( dmaChannel );
+
+	dmaBus = nullptr;
+
+	if ( interruptPin != NO_INTERRUPT_PIN )
+	{
+		gpio_set_irq_enabled( interruptPin, GPIO_IRQ_EDGE_FALL, false );
+		interruptBus = nullptr;
+	}
+}
+
+u32 Rp2040Bus::time_us()
+{
+	return time_us_32();
+}
+
+u32 Rp2040Bus::cycles_now()
+{
+	return ::cycles_now();
+}
+
+u32 Rp2040Bus::cycles_since( u32 start )
+{
+	return ::cycles_since( start );
+}
+
+void Rp2040Bus::spi_write_async( const u8 *data, u32 size )
+{
+	u32 startTime = time_us_32();
+
+	busy = true;
+	dmaDone = false;
+	frameStartTime = startTime;
+
+	gpio_put( PIN::CS, 0 );
+	dma_channel_transfer_from_buffer_now( dmaChannel, data, size );
+
+	frameKickTime = time_us_32() - startTime;
+}
+
+bool Rp2040Bus::spi_busy()
+{
+	if ( !busy )
+		return false;
+
+	if ( !dmaDone || spi_is_busy( spi0 ) )
+		return true;
+
+	gpio_put( PIN::CS, 1 );
+	busy = false;
+
+	return false;
+}
+
+bool Rp2040Bus::i2c_write( u8 address, const u8 *data, u32 size )
+{
+	return i2c_write_timeout_us( i2c0, address, data, size, false, I2C_TIMEOUT ) == static_cast<i32>( size );
+}
+
+// size bytes from each address into data, back to back. The rp2040 has to stop to change target
+// address, so this is a read per device, but with nothing else between them.
+// Returns a bit per address that answered.
+u32 Rp2040Bus::i2c_read_batch( const u8 *addresses, u32 count, u8 *data, u32 size )
+{
+	u32 answered = 0;
+
+	for ( u32 i = 0; i < count; ++i )
+	{
+		if ( i2c_read_timeout_us( i2c0, addresses[ i ], &data[ i * size ], size, false, I2C_TIMEOUT ) == static_cast<i32>( size ) )
+		{
+			answered |= 1u << i;
+		}
+	}
+
+	return answered;
+}
+
+// Idle the bus is pulled high, low between transactions means a slave is stuck mid byte
+bool Rp2040Bus::i2c_sda_low()
+{
+	return !gpio_get( PIN::SDA );
+}
+
+// Open drain by hand, the output latch stays 0. Out pulls the line low, in lets go of it
+// for the pull up, so nothing ever drives against a slave that is still holding it.
+static void i2c_line_low( u32 pin )
+{
+	gpio_set_dir( pin, GPIO_OUT );
+	sleep_us( 5 );
+}
+
+static void i2c_line_release( u32 pin )
+{
+	gpio_set_dir( pin, GPIO_IN );
+	sleep_us( 5 );
+}
+
+static void i2c_line_init( u32 pin )
+{
+	gpio_init( pin );
+	gpio_pull_up( pin );
+	gpio_put( pin, 0 );
+	gpio_set_dir( pin, GPIO_IN );
+}
+
+// A slave left mid byte holds SDA low, clock it out and send a stop
+void Rp2040Bus::i2c_recover()
+{
+	i2c_deinit( i2c0 );
+
+	i2c_line_init( PIN::SDA );
+	i2c_line_init( PIN::SCL );
+
+	for ( i32 i = 0; i < 9 && !gpio_get( PIN::SDA ); ++i )
+	{
+		i2c_line_low( PIN::SCL );
+		i2c_line_release( PIN::SCL );
+	}
+
+	// Stop condition. SDA goes low while SCL is low (low with SCL high would be a start),
+	// then SCL is released and SDA rises while it's high.
+	i2c_line_low( PIN::SCL );
+	i2c_line_low( PIN::SDA );
+	i2c_line_release( PIN::SCL );
+	i2c_line_release( PIN::SDA );
+
+	i2c_bus_init( i2cBaudrate );
+}
+
+// Whether the expander may have new input, always true without an interrupt line
+bool Rp2040Bus::input_changed()
+{
+	if ( interruptPin == NO_INTERRUPT_PIN )
+		return true;
+
+	// INT still held low means the last read missed a change
+	if ( !inputChanged && gpio_get( interruptPin ) )
+		return false;
+
+	inputChanged = false;
+
+	return true;
+}
+
+// The read failed, make sure the next input_changed tries again
+void Rp2040Bus::input_retry()
+{
+	inputChanged = true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "types.h"
+
+// The keypad's spi (apa102 leds) and i2c (tca9555 expander) on the rp2040
+struct Rp2040Bus
+{
+	static constexpr u32 SPI_BAUDRATE = 4 * 1024 * 1024;
+	static constexpr u32 I2C_TIMEOUT = 2000;						// us
+	static constexpr i32 NO_INTERRUPT_PIN = -1;
+
+	i32 dmaChannel;
+	volatile bool busy;								// until CS is back up
+	volatile bool dmaDone;							// set by the irq, the last bytes may still be in the fifo
+	u32 frameStartTime;								// us
+	u32 frameKickTime;								// us spent on the cpu starting the frame
+	volatile u32 frameCyclesSaved;					// cpu cycles the last frame saved over a blocking write
+
+	u32 i2cBaudrate;
+	i32 interruptPin;								// expander INT line, NO_INTERRUPT_PIN to poll every read
+	volatile bool inputChanged;
+
+	void init( u32 i2cSpeed, i32 expanderInterruptPin );
+	void free();
+
+	[[nodiscard]] u32 time_us();
+	[[nodiscard]] u32 cycles_now();
+	[[nodiscard]] u32 cycles_since( u32 start );
+
+	void spi_write_async( const u8 *data, u32 size );
+	[[nodiscard]] bool spi_busy();
+
+	[[nodiscard]] bool i2c_write( u8 address, const u8 *data, u32 size );
+	[[nodiscard]] u32 i2c_read_batch( const u8 *addresses, u32 count, u8 *data, u32 size );
+	[[nodiscard]] bool i2c_sda_low();
+	void i2c_recover();
+
+	[[nodiscard]] bool input_changed();
+	void input_retry();
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#ifdef LPAD_HOST
+	#include <stdint.h>
+	#include <atomic>
+#else
+	#include "hardware/sync.h"
+#endif
+
+#include "types.h"
+
+static inline void spsc_barrier()
+{
+	#ifdef LPAD_HOST
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+	#else
+		__dmb();
+	#endif
+}
+
+// Single producer, single consumer ring. Safe to share between the two cores
+// as long as one side only pushes and the other only pops.
+template <typename T, u32 N>
+struct SpscRing
+{
+	static_assert( ( N & ( N - 1 ) ) == 0, "N must be a power of 2" );
+
+	T items[ N ];
+	volatile u32 head;								// only written by the producer
+	volatile u32 tail;								// only written by the consumer
+
+	void init()
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	bool empty() const
+	{
+		return head == tail;
+	}
+
+	bool full() const
+	{
+		return head - tail >= N;
+	}
+
+	bool push( const T &item )
+	{
+		u32 h = head;
+
+		if ( h - tail >= N )
+			return false;
+
+		items[ h % N ] = item;
+
+		// The item has to land before the consumer can see the new head
+		spsc_barrier();
+
+		head = h + 1;
+
+		return true;
+	}
+
+	bool pop( T *item )
+	{
+		u32 t = tail;
+
+		if ( head == t )
+			return false;
+
+		spsc_barrier();
+
+		*item = items[ t % N ];
+
+		// Finish reading the slot before handing it back to the producer
+		spsc_barrier();
+
+		tail = t + 1;
+
+		return true;
+	}
+};
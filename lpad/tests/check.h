@@ -0,0 +1,70 @@
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+
+#include <chrono>
+
+// Just enough to fail a test, each one is an executable run by ctest
+inline int checkFailures = 0;
+
+#define CHECK( condition ) \
+	do \
+	{ \
+		if ( !( condition ) ) \
+		{ \
+			printf( "%s:%d: CHECK( %s ) failed\n", __FILE__, __LINE__, #condition ); \
+			checkFailures += 1; \
+		} \
+	} while ( 0 )
+
+// main's return, non zero if any check failed
+inline int check_result( const char *name )
+{
+	printf( "%s: %s\n", name, checkFailures ? "FAILED" : "ok" );
+	return checkFailures ? 1 : 0;
+}
+
+// Stops the compiler dropping a benchmark loop
+inline volatile unsigned long long benchmarkSink;
+
+inline double time_ns()
+{
+	return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// Chi-square with df degrees of freedom that a fair sampler only passes 0.1% of the time
+// (Wilson-Hilferty), anything above it is a failure
+inline double chi_square_limit( int df )
+{
+	double a = 2.0 / ( 9.0 * df );
+	double c = 1.0 - a + 3.0902 * sqrt( a );
+
+	return df * c * c * c;
+}
+
+inline double chi_square( const unsigned *counts, int buckets, double expected )
+{
+	double sum = 0;
+
+	for ( int i = 0; i < buckets; ++i )
+	{
+		double diff = counts[ i ] - expected;
+		sum += diff * diff / expected;
+	}
+
+	return sum;
+}
+
+inline double chi_square( const unsigned *counts, int buckets, const double *expected )
+{
+	double sum = 0;
+
+	for ( int i = 0; i < buckets; ++i )
+	{
+		double diff = counts[ i ] - expected[ i ];
+		sum += diff * diff / expected[ i ];
+	}
+
+	return sum;
+}
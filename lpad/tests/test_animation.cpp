@@ -0,0 +1,235 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "check.h"
+#include "animation.h"
+
+static constexpr i32 NUM_PADS = RGBKeypad::NUM_PADS;
+static constexpr u8 UNTOUCHED = 0x7F;				// no 5 bit channel, so any write to the pad replaces it
+static constexpr u32 START = 0xFFFFF000;			// us, the clock wraps part way through
+
+static Layer layer;
+
+static void mark_untouched()
+{
+	memset( layer.planes.r, UNTOUCHED, sizeof( layer.planes.r ) );
+	layer.dirty = false;
+}
+
+static bool pad_is( i32 pad, Colour colour, u8 brightness )
+{
+	return layer.planes.r[ pad ] == colour.r && layer.planes.g[ pad ] == colour.g && layer.planes.b[ pad ] == colour.b && layer.planes.brightness[ pad ] == brightness;
+}
+
+static u8 lerp_q8( u8 a, u8 b, u32 fraction )
+{
+	return static_cast<u8>( ( a * ( 256 - fraction ) + b * fraction ) >> 8 );
+}
+
+// -------------------------------------------------------
+// Held keyframes, a pad is only written when it moves on to the next one
+// -------------------------------------------------------
+
+static constexpr Keyframe HOLD_KEYFRAMES[] =
+{
+	{ 0, { 31, 0, 0 }, 31 },
+	{ 1000, { 0, 31, 0 }, 31 },
+	{ 3000, { 0, 0, 31 }, 16 },
+};
+
+static constexpr u32 PAD_OFFSETS[ NUM_PADS ] = { 0, 250, 500, 750, 1000, 1250, 1500, 1750, 2000, 2250, 2500, 2750, 3000, 3250, 3500, 3750 };
+
+static constexpr AnimationTrack HOLD_TRACK = { HOLD_KEYFRAMES, 3, 5000, false, PAD_OFFSETS };
+
+static void test_held_track()
+{
+	layer.alpha = Layer::OPAQUE;
+	layer.clear();
+
+	Animation animation;
+	animation.play( &HOLD_TRACK, START );
+
+	CHECK( animation.is_playing() );
+	CHECK( animation.endTime == 5000 + 3750 );
+
+	i32 shown[ NUM_PADS ];
+	u32 wrongPads = 0;
+	u32 extraWrites = 0;
+
+	for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+		shown[ pad ] = -1;
+
+	for ( u32 elapsed = 0; elapsed < animation.endTime; elapsed += 125 )
+	{
+		mark_untouched();
+
+		CHECK( animation.update( &layer, START + elapsed ) );
+
+		bool changed = false;
+
+		for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+		{
+			u32 padTime = elapsed > PAD_OFFSETS[ pad ] ? elapsed - PAD_OFFSETS[ pad ] : 0;
+			i32 k = padTime >= 3000 ? 2 : padTime >= 1000 ? 1 : 0;
+
+			if ( k == shown[ pad ] )
+			{
+				extraWrites += layer.planes.r[ pad ] != UNTOUCHED;
+				continue;
+			}
+
+			wrongPads += !pad_is( pad, HOLD_KEYFRAMES[ k ].colour, HOLD_KEYFRAMES[ k ].brightness );
+			shown[ pad ] = k;
+			changed = true;
+		}
+
+		// Nothing moved on, the layer isn't recomposited
+		extraWrites += !changed && layer.dirty;
+	}
+
+	CHECK( wrongPads == 0 );
+	CHECK( extraWrites == 0 );
+
+	for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+		CHECK( shown[ pad ] == 2 );
+
+	// The last pad's offset is the end, not the track's duration
+	CHECK( !animation.update( &layer, START + animation.endTime ) );
+	CHECK( !animation.is_playing() );
+	CHECK( !animation.update( &layer, START + animation.endTime + 1000 ) );
+}
+
+// -------------------------------------------------------
+// Interpolated keyframes, at the us
+// -------------------------------------------------------
+
+static constexpr Keyframe FADE_KEYFRAMES[] =
+{
+	{ 0, { 0, 10, 31 }, 0 },
+	{ 1024, { 31, 20, 0 }, 31 },
+};
+
+static constexpr AnimationTrack FADE_TRACK = { FADE_KEYFRAMES, 2, 2048, true, nullptr };
+
+static void test_interpolated_track()
+{
+	layer.alpha = Layer::OPAQUE;
+	layer.clear();
+
+	Animation animation;
+	animation.play( &FADE_TRACK, START );
+
+	CHECK( animation.endTime == 2048 );
+
+	u32 wrongPads = 0;
+
+	// 1024us between the keyframes is 4us per Q8 step
+	for ( u32 elapsed = 0; elapsed < 1024; elapsed += 3 )
+	{
+		CHECK( animation.update( &layer, START + elapsed ) );
+
+		u32 fraction = elapsed / 4;
+		const Keyframe &a = FADE_KEYFRAMES[ 0 ];
+		const Keyframe &b = FADE_KEYFRAMES[ 1 ];
+		Colour colour = { lerp_q8( a.colour.r, b.colour.r, fraction ), lerp_q8( a.colour.g, b.colour.g, fraction ), lerp_q8( a.colour.b, b.colour.b, fraction ) };
+
+		for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+			wrongPads += !pad_is( pad, colour, lerp_q8( a.brightness, b.brightness, fraction ) );
+	}
+
+	CHECK( wrongPads == 0 );
+
+	// The last keyframe is held, written once
+	CHECK( animation.update( &layer, START + 1024 ) );
+
+	for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+		CHECK( pad_is( pad, FADE_KEYFRAMES[ 1 ].colour, FADE_KEYFRAMES[ 1 ].brightness ) );
+
+	mark_untouched();
+
+	CHECK( animation.update( &layer, START + 2047 ) );
+	CHECK( !layer.dirty );
+	CHECK( layer.planes.r[ 0 ] == UNTOUCHED );
+
+	CHECK( !animation.update( &layer, START + 2048 ) );
+}
+
+// -------------------------------------------------------
+// Crossfade
+// -------------------------------------------------------
+
+static void test_crossfade()
+{
+	u8 from[ RGBKeypad::FRAME_SIZE ];
+	RGBKeypad::Frame to;
+
+	for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+	{
+		from[ pad * 4 + 0 ] = static_cast<u8>( 0b11100000 | pad );
+		from[ pad * 4 + 1 ] = static_cast<u8>( pad * 2 );
+		from[ pad * 4 + 2 ] = 31;
+		from[ pad * 4 + 3 ] = 0;
+
+		to.set( pad, { static_cast<u8>( 31 - pad ), 0, static_cast<u8>( pad ) }, 31 );
+	}
+
+	layer.alpha = Layer::OPAQUE;
+	layer.clear();
+
+	Crossfade fade;
+
+	// No duration goes straight to the end
+	fade.start( from, to, 0, START );
+
+	CHECK( !fade.update( &layer, START ) );
+	CHECK( !fade.active );
+
+	u32 wrongPads = 0;
+
+	for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+		wrongPads += !pad_is( pad, { to.data[ pad * 4 + 3 ], to.data[ pad * 4 + 2 ], to.data[ pad * 4 + 1 ] }, 31 );
+
+	CHECK( wrongPads == 0 );
+
+	fade.start( from, to, 1000, START );
+
+	for ( u32 elapsed = 0; elapsed < 1000; elapsed += 7 )
+	{
+		CHECK( fade.update( &layer, START + elapsed ) );
+
+		u32 fraction = ( elapsed << 8 ) / 1000;
+
+		for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+		{
+			const u8 *a = &from[ pad * 4 ];
+			const u8 *b = &to.data[ pad * 4 ];
+			Colour colour = { lerp_q8( a[ 3 ], b[ 3 ], fraction ), lerp_q8( a[ 2 ], b[ 2 ], fraction ), lerp_q8( a[ 1 ], b[ 1 ], fraction ) };
+
+			wrongPads += !pad_is( pad, colour, lerp_q8( a[ 0 ] & 0b00011111, b[ 0 ] & 0b00011111, fraction ) );
+		}
+	}
+
+	CHECK( wrongPads == 0 );
+
+	// The final frame is exactly the target, then it has stopped
+	CHECK( !fade.update( &layer, START + 1000 ) );
+
+	for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+		wrongPads += !pad_is( pad, { to.data[ pad * 4 + 3 ], to.data[ pad * 4 + 2 ], to.data[ pad * 4 + 1 ] }, 31 );
+
+	CHECK( wrongPads == 0 );
+
+	mark_untouched();
+
+	CHECK( !fade.update( &layer, START + 2000 ) );
+	CHECK( !layer.dirty );
+}
+
+int main()
+{
+	test_held_track();
+	test_interpolated_track();
+	test_crossfade();
+
+	return check_result( "animation" );
+}
@@ -0,0 +1,211 @@
+#include <stdint.h>
+
+#include "check.h"
+#include "utility.h"
+
+// The float versions' maths again in f64, floored with a little slack so a channel that is
+// exactly a whole number isn't floored one under by rounding. f32 can't tell the closest
+// non whole results apart from whole ones (1 / 31^3), f64 can, so these are the exact answers.
+static constexpr f64 WHOLE = 1e-9;
+
+static u8 exact_channel( f64 x )
+{
+	return static_cast<u8>( floor( x * 31 + WHOLE ) );
+}
+
+static Colour hsv_to_rgb_exact( Colour colour )
+{
+	f64 s = colour.g / 31.0;
+	f64 v = colour.b / 31.0;
+
+	if ( colour.g == 0 )
+		return { colour.b, colour.b, colour.b };
+
+	// Past the wheel is hue 0
+	u32 h = colour.r < 32 ? colour.r : 0;
+	u32 sector = ( h * 6 ) / 31;
+	f64 ff = ( h * 6 ) / 31.0 - sector;
+
+	f64 p = v * ( 1.0 - s );
+	f64 q = v * ( 1.0 - s * ff );
+	f64 t = v * ( 1.0 - s * ( 1.0 - ff ) );
+
+	switch ( sector )
+	{
+	case 0: return { exact_channel( v ), exact_channel( t ), exact_channel( p ) };
+	case 1: return { exact_channel( q ), exact_channel( v ), exact_channel( p ) };
+	case 2: return { exact_channel( p ), exact_channel( v ), exact_channel( t ) };
+	case 3: return { exact_channel( p ), exact_channel( q ), exact_channel( v ) };
+	case 4: return { exact_channel( t ), exact_channel( p ), exact_channel( v ) };
+	default: return { exact_channel( v ), exact_channel( p ), exact_channel( q ) };
+	}
+}
+
+static Colour rgb_to_hsv_exact( Colour colour )
+{
+	i32 r = colour.r;
+	i32 g = colour.g;
+	i32 b = colour.b;
+
+	i32 max = r > g ? ( r > b ? r : b ) : ( g > b ? g : b );
+	i32 min = r < g ? ( r < b ? r : b ) : ( g < b ? g : b );
+	f64 delta = max - min;
+
+	if ( max == min )
+		return { 0, 0, static_cast<u8>( max ) };
+
+	f64 h;
+
+	if ( r >= max )
+		h = ( g - b ) / delta;
+	else if ( g >= max )
+		h = 2.0 + ( b - r ) / delta;
+	else
+		h = 4.0 + ( r - g ) / delta;
+
+	if ( h < 0 )
+		h += 6.0;
+
+	return { exact_channel( h / 6.0 ), exact_channel( delta / max ), static_cast<u8>( max ) };
+}
+
+static u32 colour_difference( Colour a, Colour b )
+{
+	u32 r = a.r > b.r ? a.r - b.r : b.r - a.r;
+	u32 g = a.g > b.g ? a.g - b.g : b.g - a.g;
+	u32 bl = a.b > b.b ? a.b - b.b : b.b - a.b;
+
+	u32 max = r > g ? r : g;
+	return max > bl ? max : bl;
+}
+
+// -------------------------------------------------------
+// Every 5 bit input, hues past the wheel included
+// -------------------------------------------------------
+
+static void test_hsv_to_rgb()
+{
+	u32 mismatches = 0;
+	u32 referenceSlips = 0;
+	u32 referenceWorst = 0;
+
+	for ( u32 h = 0; h < 64; ++h )
+	{
+		for ( u32 s = 0; s < 32; ++s )
+		{
+			for ( u32 v = 0; v < 32; ++v )
+			{
+				Colour hsv = { static_cast<u8>( h ), static_cast<u8>( s ), static_cast<u8>( v ) };
+				Colour rgb = hsv_to_rgb( hsv );
+
+				mismatches += colour_difference( rgb, hsv_to_rgb_exact( hsv ) ) != 0;
+
+				u32 difference = colour_difference( rgb, hsv_to_rgb_reference( hsv ) );
+				referenceSlips += difference != 0;
+				referenceWorst = difference > referenceWorst ? difference : referenceWorst;
+			}
+		}
+	}
+
+	// The f32 reference only ever slips by its own rounding
+	printf( "hsv_to_rgb: %u mismatches, the f32 reference is 1 step out %u times\n", mismatches, referenceSlips );
+
+	CHECK( mismatches == 0 );
+	CHECK( referenceWorst <= 1 );
+}
+
+static void test_rgb_to_hsv()
+{
+	u32 mismatches = 0;
+	u32 referenceSlips = 0;
+	u32 referenceWorst = 0;
+	u32 greysNotZeroHue = 0;
+	u32 roundTrip = 0;
+	u32 referenceRoundTrip = 0;
+
+	for ( u32 r = 0; r < 32; ++r )
+	{
+		for ( u32 g = 0; g < 32; ++g )
+		{
+			for ( u32 b = 0; b < 32; ++b )
+			{
+				Colour rgb = { static_cast<u8>( r ), static_cast<u8>( g ), static_cast<u8>( b ) };
+				Colour hsv = rgb_to_hsv( rgb );
+				Colour referenceHsv = rgb_to_hsv_reference( rgb );
+
+				mismatches += colour_difference( hsv, rgb_to_hsv_exact( rgb ) ) != 0;
+
+				u32 difference = colour_difference( hsv, referenceHsv );
+				referenceSlips += difference != 0;
+				referenceWorst = difference > referenceWorst ? difference : referenceWorst;
+
+				// Greys, black included (the NAN branch), have hue and saturation 0
+				if ( r == g && g == b )
+					greysNotZeroHue += hsv.r != 0 || hsv.g != 0 || referenceHsv.r != 0 || referenceHsv.g != 0;
+
+				u32 error = colour_difference( rgb, hsv_to_rgb( hsv ) );
+				roundTrip = error > roundTrip ? error : roundTrip;
+
+				error = colour_difference( rgb, hsv_to_rgb_reference( referenceHsv ) );
+				referenceRoundTrip = error > referenceRoundTrip ? error : referenceRoundTrip;
+			}
+		}
+	}
+
+	printf( "rgb_to_hsv: %u mismatches, the f32 reference is 1 step out %u times\n", mismatches, referenceSlips );
+	printf( "rgb -> hsv -> rgb worst error: integer %u, reference %u\n", roundTrip, referenceRoundTrip );
+
+	CHECK( mismatches == 0 );
+	CHECK( referenceWorst <= 1 );
+	CHECK( greysNotZeroHue == 0 );
+
+	// 5 bit hsv can't hold every rgb, but the integer round trip is no worse than the float one
+	CHECK( roundTrip <= referenceRoundTrip );
+}
+
+// -------------------------------------------------------
+// ns per conversion over the whole sweep. Only the ratios say anything about the m0+,
+// where the float versions are soft float.
+// -------------------------------------------------------
+
+template <typename Convert>
+static f64 time_sweep( Convert convert )
+{
+	constexpr i32 PASSES = 64;
+
+	u64 sum = 0;
+	f64 start = time_ns();
+
+	for ( i32 pass = 0; pass < PASSES; ++pass )
+	{
+		for ( u32 x = 0; x < 32 * 32 * 32; ++x )
+		{
+			Colour colour = convert( { static_cast<u8>( x >> 10 ), static_cast<u8>( ( x >> 5 ) & 31 ), static_cast<u8>( x & 31 ) } );
+			sum += colour.r + colour.g + colour.b;
+		}
+	}
+
+	f64 ns = ( time_ns() - start ) / ( PASSES * 32 * 32 * 32 );
+
+	benchmarkSink = sum;
+
+	return ns;
+}
+
+static void benchmark_conversions()
+{
+	printf( "hsv_to_rgb reference            %6.2f ns\n", time_sweep( hsv_to_rgb_reference ) );
+	printf( "hsv_to_rgb                      %6.2f ns\n", time_sweep( hsv_to_rgb ) );
+	printf( "rgb_to_hsv reference            %6.2f ns\n", time_sweep( rgb_to_hsv_reference ) );
+	printf( "rgb_to_hsv                      %6.2f ns\n", time_sweep( rgb_to_hsv ) );
+}
+
+int main()
+{
+	test_hsv_to_rgb();
+	test_rgb_to_hsv();
+
+	benchmark_conversions();
+
+	return check_result( "colour" );
+}
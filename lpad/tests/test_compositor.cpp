@@ -0,0 +1,244 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "check.h"
+#include "compositor.h"
+
+static constexpr i32 NUM_PADS = RGBKeypad::NUM_PADS;
+
+static RGBKeypad keypad;
+static Compositor compositor;
+
+// splitmix64's finaliser, for test data
+static u64 mix( u64 z )
+{
+	z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9;
+	z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111eb;
+	return z ^ ( z >> 31 );
+}
+
+// Every layer over black a pad and a channel at a time, only where the layer draws
+static PackedColour composite_reference( i32 pad )
+{
+	u32 r = 0, g = 0, b = 0, brightness = 0;
+
+	for ( const Layer &layer : compositor.layers )
+	{
+		if ( !( ( layer.pads >> pad ) & 1 ) )
+			continue;
+
+		u32 alpha = layer.alpha;
+
+		r = ( r * ( 256 - alpha ) + layer.planes.r[ pad ] * alpha ) >> 8;
+		g = ( g * ( 256 - alpha ) + layer.planes.g[ pad ] * alpha ) >> 8;
+		b = ( b * ( 256 - alpha ) + layer.planes.b[ pad ] * alpha ) >> 8;
+		brightness = ( brightness * ( 256 - alpha ) + layer.planes.brightness[ pad ] * alpha ) >> 8;
+	}
+
+	return pack_colour( { static_cast<u8>( r ), static_cast<u8>( g ), static_cast<u8>( b ) }, static_cast<u8>( brightness ) );
+}
+
+static u32 pads_off_reference()
+{
+	u32 wrong = 0;
+
+	for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+		wrong += keypad.get_pad( pad ) != composite_reference( pad );
+
+	return wrong;
+}
+
+static void start()
+{
+	keypad.init();
+	compositor.init();
+}
+
+// -------------------------------------------------------
+// A flush with nothing changed leaves the keypad alone
+// -------------------------------------------------------
+
+static void test_flush_skipped()
+{
+	start();
+
+	CHECK( compositor.flush( &keypad ) );
+	CHECK( compositor.flushes == 1 );
+	CHECK( compositor.layersBlended == LAYER_COUNT );
+
+	keypad.dirtyPads = 0;
+
+	CHECK( !compositor.flush( &keypad ) );
+	CHECK( compositor.flushes == 1 );
+	CHECK( compositor.flushesSkipped == 1 );
+	CHECK( compositor.layersBlended == LAYER_COUNT );
+	CHECK( keypad.dirtyPads == 0 );
+
+	// Setting a pad to what it already shows isn't a change either
+	Layer *content = compositor.layer( LAYER::CONTENT );
+	content->set_colour_raw( 3, { 10, 20, 30 }, 31 );
+	CHECK( compositor.flush( &keypad ) );
+
+	content->set_colour_raw( 3, { 10, 20, 30 }, 31 );
+	CHECK( !content->dirty );
+	CHECK( !compositor.flush( &keypad ) );
+	CHECK( compositor.flushesSkipped == 2 );
+}
+
+// -------------------------------------------------------
+// Only the lowest changed layer and those above it are blended again
+// -------------------------------------------------------
+
+static void test_lowest_dirty()
+{
+	start();
+
+	Layer *background = compositor.layer( LAYER::BACKGROUND );
+	Layer *content = compositor.layer( LAYER::CONTENT );
+	Layer *overlay = compositor.layer( LAYER::OVERLAY );
+
+	background->set_colour_raw( 0, { 31, 0, 0 }, 31 );
+	content->set_colour_raw( 1, { 0, 31, 0 }, 31 );
+	overlay->set_colour_raw( 2, { 0, 0, 31 }, 31 );
+
+	CHECK( compositor.flush( &keypad ) );
+	CHECK( pads_off_reference() == 0 );
+
+	u32 blended = compositor.layersBlended;
+
+	overlay->set_colour_raw( 2, { 0, 0, 16 }, 31 );
+	CHECK( compositor.flush( &keypad ) );
+	CHECK( compositor.layersBlended - blended == 1 );
+	CHECK( pads_off_reference() == 0 );
+
+	blended = compositor.layersBlended;
+
+	content->set_colour_raw( 1, { 0, 16, 0 }, 31 );
+	CHECK( compositor.flush( &keypad ) );
+	CHECK( compositor.layersBlended - blended == 2 );
+	CHECK( pads_off_reference() == 0 );
+
+	// The background and the overlay changed, the content between is blended again too
+	blended = compositor.layersBlended;
+
+	background->set_colour_raw( 0, { 16, 0, 0 }, 31 );
+	overlay->set_alpha( 128 );
+	CHECK( compositor.flush( &keypad ) );
+	CHECK( compositor.layersBlended - blended == 3 );
+	CHECK( pads_off_reference() == 0 );
+
+	// What's kept composited below the change is still what those layers show
+	blended = compositor.layersBlended;
+
+	overlay->set_colour_raw( 5, { 31, 31, 31 }, 31 );
+	CHECK( compositor.flush( &keypad ) );
+	CHECK( compositor.layersBlended - blended == 1 );
+	CHECK( pads_off_reference() == 0 );
+	CHECK( keypad.get_pad( 0 ) == pack_colour( { 16, 0, 0 }, 31 ) );
+}
+
+// -------------------------------------------------------
+// Pads a layer doesn't draw show what's below, whatever its alpha
+// -------------------------------------------------------
+
+static void test_partial_pads()
+{
+	start();
+
+	Layer *background = compositor.layer( LAYER::BACKGROUND );
+	Layer *content = compositor.layer( LAYER::CONTENT );
+
+	for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+		background->set_colour_raw( pad, { static_cast<u8>( pad ), static_cast<u8>( 31 - pad ), 7 }, 20 );
+
+	content->set_colour_raw( 0, { 31, 31, 31 }, 31 );
+	content->set_colour_raw( 5, { 1, 2, 3 }, 4 );
+	content->set_colour_raw( 15, { 0, 0, 0 }, 0 );
+
+	CHECK( content->pads == ( 1 << 0 | 1 << 5 | 1 << 15 ) );
+	CHECK( compositor.flush( &keypad ) );
+
+	for ( i32 pad = 0; pad < NUM_PADS; ++pad )
+	{
+		if ( pad == 0 )
+			CHECK( keypad.get_pad( pad ) == pack_colour( { 31, 31, 31 }, 31 ) );
+		else if ( pad == 5 )
+			CHECK( keypad.get_pad( pad ) == pack_colour( { 1, 2, 3 }, 4 ) );
+		else if ( pad == 15 )
+			CHECK( keypad.get_pad( pad ) == pack_colour( { 0, 0, 0 }, 0 ) );
+		else
+			CHECK( keypad.get_pad( pad ) == pack_colour( { static_cast<u8>( pad ), static_cast<u8>( 31 - pad ), 7 }, 20 ) );
+	}
+
+	// Half see through, still only over its own pads
+	content->set_alpha( 128 );
+	CHECK( compositor.flush( &keypad ) );
+	CHECK( pads_off_reference() == 0 );
+	CHECK( keypad.get_pad( 1 ) == pack_colour( { 1, 30, 7 }, 20 ) );
+
+	// Cleared, nothing drawn, the background shows everywhere
+	content->clear();
+	CHECK( compositor.flush( &keypad ) );
+	CHECK( keypad.get_pad( 0 ) == pack_colour( { 0, 31, 7 }, 20 ) );
+	CHECK( pads_off_reference() == 0 );
+}
+
+// -------------------------------------------------------
+// Random layers, pads and alphas against the per channel reference
+// -------------------------------------------------------
+
+static void test_alpha_blend()
+{
+	start();
+	compositor.flush( &keypad );
+
+	u64 counter = 0x5EED;
+	u32 wrongPads = 0;
+	u32 wrongBlends = 0;
+
+	for ( i32 round = 0; round < 20000; ++round )
+	{
+		u64 bits = mix( counter++ );
+		i32 lowest = LAYER_COUNT;
+
+		// Change one to three layers a round
+		for ( i32 change = 0; change <= static_cast<i32>( bits % 3 ); ++change )
+		{
+			bits = mix( bits );
+
+			i32 index = static_cast<i32>( bits % LAYER_COUNT );
+			Layer &layer = compositor.layers[ index ];
+			u32 what = ( bits >> 8 ) % 8;
+
+			if ( what == 0 )
+				layer.clear();
+			else if ( what <= 2 )
+				layer.set_alpha( static_cast<u16>( ( bits >> 16 ) % 257 ) );
+			else
+				layer.set_colour_raw( static_cast<i32>( ( bits >> 16 ) % NUM_PADS ), { static_cast<u8>( ( bits >> 24 ) & 31 ), static_cast<u8>( ( bits >> 32 ) & 31 ), static_cast<u8>( ( bits >> 40 ) & 31 ) }, static_cast<u8>( ( bits >> 48 ) & 31 ) );
+
+			if ( layer.dirty && index < lowest )
+				lowest = index;
+		}
+
+		u32 blended = compositor.layersBlended;
+		bool flushed = compositor.flush( &keypad );
+
+		wrongBlends += flushed != ( lowest < LAYER_COUNT );
+		wrongBlends += compositor.layersBlended - blended != static_cast<u32>( LAYER_COUNT - lowest );
+		wrongPads += pads_off_reference();
+	}
+
+	CHECK( wrongBlends == 0 );
+	CHECK( wrongPads == 0 );
+}
+
+int main()
+{
+	test_flush_skipped();
+	test_lowest_dirty();
+	test_partial_pads();
+	test_alpha_blend();
+
+	return check_result( "compositor" );
+}
@@ -0,0 +1,233 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "check.h"
+#include "rgb_keypad.h"
+
+using Chain = RGBKeypadChain<4, 4, 2>;
+
+static Chain chain;
+static RGBKeypad keypad;
+
+// Two expanders at 0x20 and 0x21, each with its own script
+static void test_chain_buttons()
+{
+	chain.init();
+
+	chain.bus.expanders[ 0 ].buttonScript = { 1 << 3 };
+	chain.bus.expanders[ 1 ].buttonScript = { 1 << 5 };
+
+	CHECK( chain.get_button_states() == ( Chain::PadMask( 1 ) << 3 | Chain::PadMask( 1 ) << ( 16 + 5 ) ) );
+
+	// The pointer is written once, after that every read is just the port
+	for ( i32 i = 0; i < 3; ++i )
+		CHECK( chain.get_button_states() == ( Chain::PadMask( 1 ) << 3 | Chain::PadMask( 1 ) << ( 16 + 5 ) ) );
+
+	CHECK( chain.bus.expanders[ 0 ].pointerWrites == 1 );
+	CHECK( chain.bus.expanders[ 1 ].pointerWrites == 1 );
+	CHECK( chain.bus.expanders[ 0 ].reads == 4 );
+	CHECK( chain.bus.expanders[ 1 ].reads == 4 );
+	CHECK( chain.bus.expanders[ 2 ].reads == 0 );
+	CHECK( chain.i2cErrors == 0 );
+
+	// The second expander misses one read, it is read again with its pointer rewritten. A nack
+	// with SDA released doesn't need the bus recovered.
+	chain.bus.expanders[ 0 ].buttonScript = { 0 };
+	chain.bus.expanders[ 1 ].buttonScript = { 1 << 15 | 1 << 0 };
+	chain.bus.expanders[ 1 ].failReads = 1;
+
+	CHECK( chain.get_button_states() == ( Chain::PadMask( 1 ) << 16 | Chain::PadMask( 1 ) << 31 ) );
+	CHECK( chain.bus.i2cRecoveries == 0 );
+	CHECK( chain.bus.expanders[ 1 ].pointerWrites == 2 );
+	CHECK( chain.bus.expanders[ 0 ].pointerWrites == 1 );
+	CHECK( chain.i2cErrors == 1 );
+
+	// The plain retry fails too, then the bus is recovered before the next
+	chain.bus.expanders[ 1 ].failReads = 2;
+
+	CHECK( chain.get_button_states() == ( Chain::PadMask( 1 ) << 16 | Chain::PadMask( 1 ) << 31 ) );
+	CHECK( chain.bus.i2cRecoveries == 1 );
+	CHECK( chain.bus.expanders[ 1 ].pointerWrites == 3 );
+	CHECK( chain.i2cErrors == 3 );
+
+	// A slave holding SDA low is recovered before the first retry
+	chain.bus.expanders[ 1 ].failReads = 1;
+	chain.bus.sdaHeld = true;
+
+	CHECK( chain.get_button_states() == ( Chain::PadMask( 1 ) << 16 | Chain::PadMask( 1 ) << 31 ) );
+	CHECK( chain.bus.i2cRecoveries == 2 );
+	CHECK( !chain.bus.sdaHeld );
+	CHECK( chain.bus.expanders[ 1 ].pointerWrites == 4 );
+	CHECK( chain.i2cErrors == 4 );
+
+	// The second expander is gone for longer than the retries, it keeps its last state and the first still updates
+	chain.bus.expanders[ 0 ].buttonScript = { 1 << 9 };
+	chain.bus.expanders[ 1 ].buttonScript = { 0 };
+	chain.bus.expanders[ 1 ].failReads = 1 + Chain::I2C_RETRIES * 2;
+
+	CHECK( chain.get_button_states() == ( Chain::PadMask( 1 ) << 9 | Chain::PadMask( 1 ) << 16 | Chain::PadMask( 1 ) << 31 ) );
+
+	// Back again
+	chain.bus.expanders[ 1 ].failReads = 0;
+
+	CHECK( chain.get_button_states() == Chain::PadMask( 1 ) << 9 );
+}
+
+// x carries on into the next keypad, and the leds of both go out in one spi frame
+static void test_chain_leds()
+{
+	static_assert( Chain::WIDTH == 8 && Chain::HEIGHT == 4 && Chain::NUM_PADS == 32 );
+	static_assert( Chain::END_FRAME_SIZE == 4 );
+	static_assert( Chain::BUFFER_SIZE == 4 + 32 * 4 + 4 );
+	static_assert( std::is_same_v<Chain::PadMask, u32> );
+
+	chain.init();
+	chain.gammaOutput = false;
+	chain.bus.spiFrames.clear();
+
+	u8 x = 5, y = 2, r = 31, g = 16, b = 1;
+
+	chain.set_colour( x, y, r, g, b );
+
+	i32 index = 16 + 2 * 4 + 1;
+
+	CHECK( chain.ledData[ index * 4 + 1 ] == 1 );
+	CHECK( chain.ledData[ index * 4 + 2 ] == 16 );
+	CHECK( chain.ledData[ index * 4 + 3 ] == 31 );
+	CHECK( chain.dirtyPads == Chain::PadMask( 1 ) << index );
+
+	chain.update();
+
+	CHECK( chain.bus.spiFrames.size() == 1 );
+
+	if ( chain.bus.spiFrames.size() == 1 )
+	{
+		const std::vector<u8> &frame = chain.bus.spiFrames[ 0 ];
+
+		CHECK( frame.size() == Chain::BUFFER_SIZE );
+		CHECK( frame[ 0 ] == 0 && frame[ 1 ] == 0 && frame[ 2 ] == 0 && frame[ 3 ] == 0 );
+		CHECK( frame[ Chain::START_FRAME_SIZE + index * 4 + 3 ] == 31 );
+		CHECK( frame[ Chain::BUFFER_SIZE - 1 ] == 0 );
+	}
+
+	// Off the end of the chain is ignored
+	u8 pastEnd = Chain::WIDTH, pastBottom = Chain::HEIGHT, zero = 0;
+
+	chain.set_colour( pastEnd, zero, r, g, b );
+	chain.set_colour( zero, pastBottom, r, g, b );
+
+	CHECK( chain.dirtyPads == 0 );
+}
+
+// Every brightness and colour of one channel, sent again every DITHER_REFRESH_RATE. Full white
+// stays at the current a raw 31 drew, the output only ever moves between two neighbouring pwm
+// steps and spends no more than 3 frames in a row on either, so nothing dithers slow enough to
+// see, and the average over many frames goes up with the colour.
+static void test_dither_refresh()
+{
+	constexpr i32 FRAMES = 256;
+	constexpr i32 MAX_RUN = 3;
+	constexpr i32 RED = RGBKeypad::START_FRAME_SIZE + 3;
+
+	keypad.init();
+
+	u32 outOfCurrent = 0;
+	u32 tooDim = 0;
+	u32 notNeighbours = 0;
+	u32 longRuns = 0;
+	u32 outOfOrder = 0;
+	u32 darkColours = 0;
+
+	for ( u8 brightness = 1; brightness <= RGBKeypad::MAX_BRIGHTNESS; ++brightness )
+	{
+		u32 lastSum = 0;
+
+		for ( u8 colour = 0; colour <= RGBKeypad::MAX_COLOUR; ++colour )
+		{
+			keypad.set_colour_raw( 0, Colour { colour, 0, 0 }, brightness );
+			keypad.bus.spiFrames.clear();
+
+			CHECK( keypad.update_async() );
+
+			for ( i32 frame = 1; frame < FRAMES; ++frame )
+			{
+				keypad.bus.time += RGBKeypad::DITHER_REFRESH_RATE;
+				keypad.update_async();
+			}
+
+			const std::vector<std::vector<u8>> &frames = keypad.bus.spiFrames;
+			u32 wire = frames[ 0 ][ RGBKeypad::START_FRAME_SIZE ] & 0b00011111;
+			u32 low = 255;
+			u32 high = 0;
+			u32 sum = 0;
+
+			for ( const std::vector<u8> &frame : frames )
+			{
+				low = frame[ RED ] < low ? frame[ RED ] : low;
+				high = frame[ RED ] > high ? frame[ RED ] : high;
+				sum += frame[ RED ];
+			}
+
+			// A steady colour is sent once and left alone
+			if ( low == high && frames.size() != 1 )
+				longRuns += 1;
+
+			if ( low != high )
+			{
+				CHECK( frames.size() == FRAMES );
+
+				notNeighbours += high - low != 1;
+
+				i32 run = 0;
+
+				for ( i32 frame = 1; frame < static_cast<i32>( frames.size() ); ++frame )
+				{
+					run = frames[ frame ][ RED ] == frames[ frame - 1 ][ RED ] ? run + 1 : 0;
+					longRuns += run >= MAX_RUN;
+				}
+			}
+
+			if ( colour == RGBKeypad::MAX_COLOUR )
+			{
+				outOfCurrent += wire * high > brightness * RGBKeypad::CURRENT_PWM;
+				tooDim += wire * ( high + 1 ) <= brightness * RGBKeypad::CURRENT_PWM;
+			}
+
+			sum = sum * FRAMES / static_cast<u32>( frames.size() );
+			darkColours += colour > 0 && sum == 0;
+			outOfOrder += sum < lastSum;
+			lastSum = sum;
+		}
+	}
+
+	CHECK( outOfCurrent == 0 );
+	CHECK( tooDim == 0 );
+	CHECK( notNeighbours == 0 );
+	CHECK( longRuns == 0 );
+	CHECK( outOfOrder == 0 );
+	CHECK( darkColours == 0 );
+}
+
+// The single keypad only ever talks to 0x20
+static void test_single_keypad()
+{
+	keypad.init();
+
+	keypad.bus.expanders[ 0 ].buttonScript = { 1 << 0, 1 << 15 };
+	keypad.bus.expanders[ 1 ].buttonScript = { 0xFFFF };
+
+	CHECK( keypad.get_button_states() == 1 << 0 );
+	CHECK( keypad.get_button_states() == 1 << 15 );
+	CHECK( keypad.bus.expanders[ 1 ].reads == 0 );
+	CHECK( keypad.bus.expanders[ 1 ].pointerWrites == 0 );
+}
+
+int main()
+{
+	test_chain_buttons();
+	test_chain_leds();
+	test_single_keypad();
+	test_dither_refresh();
+
+	return check_result( "keypad" );
+}
@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "check.h"
+#include "keypad_input.h"
+
+static RGBKeypad keypad;
+static KeypadInput input;
+
+static constexpr u32 SAMPLE_RATE = KeypadInput::DEFAULT_SAMPLE_RATE;
+static constexpr u32 APP_TICK = 16000;				// us, how often the app pops its events
+
+// Each pad is pressed for script entries [ start, end )
+struct ScriptPress
+{
+	u8 key;
+	u32 start;
+	u32 end;
+};
+
+// One script entry per sample, every entry is read once
+static void set_script( const ScriptPress *presses, u32 count, u32 samples )
+{
+	std::vector<u16> script( samples, 0 );
+
+	for ( u32 i = 0; i < count; ++i )
+	{
+		for ( u32 sample = presses[ i ].start; sample < presses[ i ].end; ++sample )
+			script[ sample ] |= static_cast<u16>( 1 << presses[ i ].key );
+	}
+
+	keypad.bus.expanders[ 0 ].buttonScript = script;
+}
+
+static void start()
+{
+	keypad.init();
+	input.init( &keypad, SAMPLE_RATE );
+}
+
+// Time moves on a sample at a time, the sample for script entry n lands at ( n + 1 ) samples
+static void run_for( u32 us )
+{
+	for ( u32 end = keypad.bus.time + us; keypad.bus.time < end; )
+	{
+		keypad.bus.time += SAMPLE_RATE;
+		CHECK( input.update() );
+	}
+}
+
+static u32 pop_all( KeyEvent *events, u32 max )
+{
+	u32 count = 0;
+
+	while ( count < max && input.pop( &events[ count ] ) )
+		count += 1;
+
+	return count;
+}
+
+// Contact bounce flips the raw state every sample, no key changes until it has agreed for
+// DEBOUNCE_SAMPLES in a row
+static void test_bounce()
+{
+	start();
+
+	static constexpr ScriptPress BOUNCE[] =
+	{
+		{ 2, 0, 1 }, { 2, 2, 3 }, { 2, 4, 5 }, { 2, 6, 7 },			// chatter, never settles
+		{ 2, 8, 30 },												// held
+		{ 2, 31, 32 }, { 2, 33, 34 },								// bounces on the way back up
+	};
+
+	set_script( BOUNCE, sizeof( BOUNCE ) / sizeof( BOUNCE[ 0 ] ), 60 );
+
+	KeyEvent events[ 4 ];
+
+	run_for( 8 * SAMPLE_RATE );
+	CHECK( pop_all( events, 4 ) == 0 );
+	CHECK( input.keysDown == 0 );
+
+	// The hold starts counting from nothing
+	run_for( ( KeypadInput::DEBOUNCE_SAMPLES - 1 ) * SAMPLE_RATE );
+	CHECK( pop_all( events, 4 ) == 0 );
+
+	run_for( SAMPLE_RATE );
+	CHECK( pop_all( events, 4 ) == 1 );
+	CHECK( events[ 0 ].key == 2 && events[ 0 ].pressed );
+	CHECK( events[ 0 ].time == keypad.bus.time );
+	CHECK( events[ 0 ].keysDown == RGBKeypad::PadMask( 1 ) << 2 );
+
+	// Released at entry 30, the bounces at 31 and 33 hold it off until entry 38
+	run_for( 38 * SAMPLE_RATE - keypad.bus.time );
+	CHECK( pop_all( events, 4 ) == 0 );
+	CHECK( input.keysDown == RGBKeypad::PadMask( 1 ) << 2 );
+
+	run_for( SAMPLE_RATE );
+	CHECK( pop_all( events, 4 ) == 1 );
+	CHECK( events[ 0 ].key == 2 && !events[ 0 ].pressed );
+	CHECK( events[ 0 ].time == 39 * SAMPLE_RATE );
+	CHECK( events[ 0 ].keysDown == 0 );
+
+	// Settled, no more events however long it runs
+	run_for( 20 * SAMPLE_RATE );
+	CHECK( pop_all( events, 4 ) == 0 );
+	CHECK( input.keysSettling == 0 );
+}
+
+// A tap that starts and ends between two app ticks still reaches the app, the press
+// and the release both wait in the ring for the next tick
+static void test_short_press()
+{
+	start();
+
+	static constexpr ScriptPress TAP[] = { { 9, 1, 1 + KeypadInput::DEBOUNCE_SAMPLES } };
+	set_script( TAP, 1, 32 );
+
+	run_for( APP_TICK );
+
+	KeyEvent events[ 4 ];
+
+	CHECK( pop_all( events, 4 ) == 2 );
+	CHECK( events[ 0 ].key == 9 && events[ 0 ].pressed );
+	CHECK( events[ 1 ].key == 9 && !events[ 1 ].pressed );
+	CHECK( events[ 0 ].time < events[ 1 ].time );
+	CHECK( events[ 1 ].time - events[ 0 ].time == KeypadInput::DEBOUNCE_SAMPLES * SAMPLE_RATE );
+	CHECK( events[ 1 ].time <= APP_TICK );
+	CHECK( input.keysDown == 0 );
+}
+
+// Overlapping presses come out in the order they settled, with times that only go up
+static void test_event_order()
+{
+	start();
+
+	// A pad held over [ start, end ) settles DEBOUNCE_SAMPLES - 1 entries later, at the sample
+	// after that. Presses 0 (5ms) 3 (7ms) 7 (10ms) 12 (13ms), releases 3 (17ms) 12 (19ms)
+	// 0 (25ms) 7 (35ms).
+	static constexpr ScriptPress PRESSES[] = { { 0, 0, 20 }, { 3, 2, 12 }, { 7, 5, 30 }, { 12, 8, 14 } };
+	set_script( PRESSES, sizeof( PRESSES ) / sizeof( PRESSES[ 0 ] ), 40 );
+
+	static constexpr struct
+	{
+		u8 key;
+		bool pressed;
+		u32 time;
+		RGBKeypad::PadMask keysDown;
+	} EXPECTED[] =
+	{
+		{ 0, true, 5000, 0x0001 },
+		{ 3, true, 7000, 0x0009 },
+		{ 7, true, 10000, 0x0089 },
+		{ 12, true, 13000, 0x1089 },
+		{ 3, false, 17000, 0x1081 },
+		{ 12, false, 19000, 0x0081 },
+		{ 0, false, 25000, 0x0080 },
+		{ 7, false, 35000, 0x0000 },
+	};
+
+	constexpr u32 EXPECTED_COUNT = sizeof( EXPECTED ) / sizeof( EXPECTED[ 0 ] );
+
+	KeyEvent events[ KeypadInput::MAX_EVENTS ];
+	u32 count = 0;
+
+	// Popped every app tick, as main does
+	while ( keypad.bus.time < 40 * SAMPLE_RATE )
+	{
+		run_for( APP_TICK );
+		count += pop_all( &events[ count ], KeypadInput::MAX_EVENTS - count );
+	}
+
+	CHECK( count == EXPECTED_COUNT );
+	CHECK( input.eventsDropped == 0 );
+
+	for ( u32 i = 0; i < count && i < EXPECTED_COUNT; ++i )
+	{
+		CHECK( events[ i ].key == EXPECTED[ i ].key );
+		CHECK( events[ i ].pressed == EXPECTED[ i ].pressed );
+		CHECK( events[ i ].time == EXPECTED[ i ].time );
+		CHECK( events[ i ].keysDown == EXPECTED[ i ].keysDown );
+
+		if ( i > 0 )
+			CHECK( events[ i ].time > events[ i - 1 ].time );
+	}
+}
+
+int main()
+{
+	test_bounce();
+	test_short_press();
+	test_event_order();
+
+	return check_result( "keypad_input" );
+}
@@ -0,0 +1,132 @@
+#include <stdint.h>
+
+#include "check.h"
+#include "packed_colour.h"
+
+// Each lane on its own, what the swar versions have to match
+static u32 add_saturate_reference( u32 a, u32 b )
+{
+	return a + b < 31 ? a + b : 31;
+}
+
+static u32 scale_q8_reference( u32 a, u32 fraction )
+{
+	return ( a * fraction ) >> 8;
+}
+
+static u32 lerp_q8_reference( u32 a, u32 b, u32 fraction )
+{
+	return ( a * ( 256 - fraction ) + b * fraction ) >> 8;
+}
+
+static u32 lane( PackedColour colour, i32 index )
+{
+	return ( colour >> ( index * 8 ) ) & 0xFF;
+}
+
+// Lanes brightness, b, g, r from x and y stepped on by a stride a lane. Over every x and y
+// each lane sees every value, next to neighbours that are the same (stride 0), one off, or
+// far apart, so a carry or borrow into the next lane up shows.
+static constexpr u32 STRIDES[] = { 0, 1, 11, 31 };
+
+static PackedColour make_packed( u32 x, u32 stride )
+{
+	PackedColour colour = PACKED_HEADER;
+
+	for ( i32 index = 0; index < 4; ++index )
+		colour |= ( ( x + index * stride ) & 31 ) << ( index * 8 );
+
+	return colour;
+}
+
+// -------------------------------------------------------
+// Every 5 bit pair in every lane, every fraction 0-256
+// -------------------------------------------------------
+
+static void test_add_saturate()
+{
+	u32 mismatches = 0;
+
+	for ( u32 stride : STRIDES )
+	{
+		for ( u32 x = 0; x < 32; ++x )
+		{
+			for ( u32 y = 0; y < 32; ++y )
+			{
+				PackedColour a = make_packed( x, stride );
+				PackedColour b = make_packed( y, 31 - stride );
+				PackedColour sum = packed_add_saturate( a, b );
+
+				mismatches += lane( sum, 0 ) != ( PACKED_HEADER | add_saturate_reference( lane( a, 0 ) & 31, lane( b, 0 ) & 31 ) );
+
+				for ( i32 index = 1; index < 4; ++index )
+					mismatches += lane( sum, index ) != add_saturate_reference( lane( a, index ), lane( b, index ) );
+			}
+		}
+	}
+
+	CHECK( mismatches == 0 );
+}
+
+static void test_scale_q8()
+{
+	u32 mismatches = 0;
+
+	for ( u32 stride : STRIDES )
+	{
+		for ( u32 x = 0; x < 32; ++x )
+		{
+			PackedColour a = make_packed( x, stride );
+
+			for ( u32 fraction = 0; fraction <= 256; ++fraction )
+			{
+				PackedColour scaled = packed_scale_q8( a, fraction );
+
+				mismatches += lane( scaled, 0 ) != ( PACKED_HEADER | scale_q8_reference( lane( a, 0 ) & 31, fraction ) );
+
+				for ( i32 index = 1; index < 4; ++index )
+					mismatches += lane( scaled, index ) != scale_q8_reference( lane( a, index ), fraction );
+			}
+		}
+	}
+
+	CHECK( mismatches == 0 );
+}
+
+static void test_lerp_q8()
+{
+	u32 mismatches = 0;
+
+	for ( u32 stride : STRIDES )
+	{
+		for ( u32 x = 0; x < 32; ++x )
+		{
+			for ( u32 y = 0; y < 32; ++y )
+			{
+				PackedColour a = make_packed( x, stride );
+				PackedColour b = make_packed( y, 31 - stride );
+
+				for ( u32 fraction = 0; fraction <= 256; ++fraction )
+				{
+					PackedColour lerped = packed_lerp_q8( a, b, fraction );
+
+					mismatches += lane( lerped, 0 ) != ( PACKED_HEADER | lerp_q8_reference( lane( a, 0 ) & 31, lane( b, 0 ) & 31, fraction ) );
+
+					for ( i32 index = 1; index < 4; ++index )
+						mismatches += lane( lerped, index ) != lerp_q8_reference( lane( a, index ), lane( b, index ), fraction );
+				}
+			}
+		}
+	}
+
+	CHECK( mismatches == 0 );
+}
+
+int main()
+{
+	test_add_saturate();
+	test_scale_q8();
+	test_lerp_q8();
+
+	return check_result( "packed_colour" );
+}
@@ -0,0 +1,137 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "check.h"
+#include "photon_smash.h"
+
+// The solver from before the bitboard, a byte per pad toggled in place
+static bool photon_smash_solvability_check( u8 lights[ RGBKeypad::NUM_PADS ] )
+{
+	// Attempt to solve the state
+	for ( i32 index = 4; index < RGBKeypad::NUM_PADS; ++index )
+	{
+		if ( lights[ index - 4 ] )
+		{
+			lights[ index ] = !lights[ index ];
+			lights[ index - 4 ] = !lights[ index - 4 ];
+
+			// Check its not at the bottom edge
+			if ( index < 12 )
+			{
+				lights[ index + 4 ] = !lights[ index + 4 ];
+			}
+
+			// Check its not at the left edge
+			if ( index % 4 != 0 )
+			{
+				lights[ index - 1 ] = !lights[ index - 1 ];
+			}
+
+			// Check its not at the right edge
+			if ( ( index + 1 ) % 4 != 0 )
+			{
+				lights[ index + 1 ] = !lights[ index + 1 ];
+			}
+		}
+	}
+
+	// If any lights are still on it failed
+	for ( i32 index = 0; index < RGBKeypad::NUM_PADS; ++index )
+	{
+		if ( lights[ index ] )
+			return false;
+	}
+
+	return true;
+}
+
+static void board_to_lights( u16 board, u8 lights[ RGBKeypad::NUM_PADS ] )
+{
+	for ( i32 index = 0; index < RGBKeypad::NUM_PADS; ++index )
+		lights[ index ] = ( board >> index ) & 1;
+}
+
+// Every board, the bitboard solver against the array one
+static void test_solvable()
+{
+	u32 mismatches = 0;
+	u32 solvable = 0;
+
+	for ( u32 board = 0; board <= 0xFFFF; ++board )
+	{
+		u8 lights[ RGBKeypad::NUM_PADS ];
+		board_to_lights( static_cast<u16>( board ), lights );
+
+		bool expected = photon_smash_solvability_check( lights );
+
+		mismatches += photon_smash_solvable( static_cast<u16>( board ) ) != expected;
+		solvable += expected;
+	}
+
+	CHECK( mismatches == 0 );
+
+	// The 4x4 press matrix has rank 12, so 2^12 boards can be cleared
+	CHECK( solvable == 4096 );
+}
+
+// photon_smash_press() from before the bitboard, on the array
+static void photon_smash_press( u8 lights[ RGBKeypad::NUM_PADS ], i32 index )
+{
+	lights[ index ] = !lights[ index ];
+
+	// Check its not at the top edge
+	if ( index > 3 )
+	{
+		lights[ index - 4 ] = !lights[ index - 4 ];
+	}
+
+	// Check its not at the bottom edge
+	if ( index < 12 )
+	{
+		lights[ index + 4 ] = !lights[ index + 4 ];
+	}
+
+	// Check its not at the left edge
+	if ( index % 4 != 0 )
+	{
+		lights[ index - 1 ] = !lights[ index - 1 ];
+	}
+
+	// Check its not at the right edge
+	if ( ( index + 1 ) % 4 != 0 )
+	{
+		lights[ index + 1 ] = !lights[ index + 1 ];
+	}
+}
+
+// Every press on every board, xor with the mask against the old toggles
+static void test_press_masks()
+{
+	u32 mismatches = 0;
+
+	for ( u32 board = 0; board <= 0xFFFF; ++board )
+	{
+		for ( i32 index = 0; index < RGBKeypad::NUM_PADS; ++index )
+		{
+			u8 lights[ RGBKeypad::NUM_PADS ];
+			u8 expected[ RGBKeypad::NUM_PADS ];
+
+			board_to_lights( static_cast<u16>( board ), expected );
+			photon_smash_press( expected, index );
+
+			board_to_lights( static_cast<u16>( board ^ photonSmashPressMasks.masks[ index ] ), lights );
+
+			mismatches += memcmp( lights, expected, sizeof( lights ) ) != 0;
+		}
+	}
+
+	CHECK( mismatches == 0 );
+}
+
+int main()
+{
+	test_press_masks();
+	test_solvable();
+
+	return check_result( "photon_smash" );
+}
@@ -0,0 +1,1012 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+
+#include "check.h"
+#include "random.h"
+
+static constexpr u64 SEED = 0x5EED;
+
+// Counts into buckets and checks them against a fair sampler
+template <u32 BUCKETS>
+struct Buckets
+{
+	u32 counts[ BUCKETS ] = {};
+	u32 total = 0;
+
+	void add( u64 bucket )
+	{
+		counts[ bucket ] += 1;
+		total += 1;
+	}
+
+	bool fair() const
+	{
+		return chi_square( counts, BUCKETS, static_cast<f64>( total ) / BUCKETS ) < chi_square_limit( BUCKETS - 1 );
+	}
+};
+
+// -------------------------------------------------------
+// bounded(), every engine
+// -------------------------------------------------------
+
+template <typename Engine>
+static void test_bounded_32()
+{
+	constexpr i32 DRAWS = 120000;
+
+	Random<Engine> random;
+	random.set_seed( SEED );
+
+	Buckets<6> dice;
+	Buckets<100> percent;
+
+	for ( i32 i = 0; i < DRAWS; ++i )
+	{
+		dice.add( random.bounded( 6u ) );
+		percent.add( random.bounded( 100u ) );
+	}
+
+	CHECK( dice.fair() );
+	CHECK( percent.fair() );
+
+	// 3 * 2^30 is where bias shows. Modulo would put half the draws in the bottom third,
+	// multiply and shift without the rejection would put half of them on multiples of 3.
+	constexpr u32 RANGE = UINT32_C( 3 ) << 30;
+
+	Buckets<3> thirds;
+	Buckets<3> residues;
+
+	for ( i32 i = 0; i < DRAWS; ++i )
+	{
+		u32 x = random.bounded( RANGE );
+
+		CHECK( x < RANGE );
+
+		thirds.add( x >> 30 );
+		residues.add( x % 3 );
+	}
+
+	CHECK( thirds.fair() );
+	CHECK( residues.fair() );
+}
+
+template <typename Engine>
+static void test_bounded_64()
+{
+	constexpr i32 DRAWS = 60000;
+
+	Random<Engine> random;
+	random.set_seed( SEED );
+
+	// Just past 32 bits and the same worst case as above at the top of 64 bits
+	constexpr u64 SMALL_RANGE = UINT64_C( 3 ) << 32;
+	constexpr u64 RANGE = UINT64_C( 3 ) << 62;
+
+	Buckets<3> smallThirds;
+	Buckets<3> thirds;
+	Buckets<3> residues;
+
+	for ( i32 i = 0; i < DRAWS; ++i )
+	{
+		u64 small = random.bounded( SMALL_RANGE );
+		u64 x = random.bounded( RANGE );
+
+		CHECK( small < SMALL_RANGE );
+		CHECK( x < RANGE );
+
+		smallThirds.add( small >> 32 );
+		thirds.add( x >> 62 );
+		residues.add( x % 3 );
+	}
+
+	CHECK( smallThirds.fair() );
+	CHECK( thirds.fair() );
+	CHECK( residues.fair() );
+
+	// A range of 0 is the whole type, every bit turns up
+	u64 bits = 0;
+
+	for ( i32 i = 0; i < 64; ++i )
+		bits |= random.bounded( UINT64_C( 0 ) );
+
+	CHECK( bits == UINT64_MAX );
+}
+
+template <typename Engine>
+static void test_bounded()
+{
+	test_bounded_32<Engine>();
+	test_bounded_64<Engine>();
+}
+
+// -------------------------------------------------------
+// random_at() and irandom_at(), counter based so nothing is stepped
+// -------------------------------------------------------
+
+static void test_random_at()
+{
+	constexpr u64 STREAMS = 64;
+	constexpr u64 INDICES = 64;
+
+	random_set_seed( SEED );
+
+	u64 first = random_at( 3, 17 );
+	u32 firstBounded = irandom_at( 3, 17, 1000 );
+
+	// Drawing from the streams doesn't move it, the seed does
+	for ( i32 i = 0; i < 100; ++i )
+		(void) irandom( 100 );
+
+	CHECK( random_at( 3, 17 ) == first );
+	CHECK( irandom_at( 3, 17, 1000 ) == firstBounded );
+
+	random_set_seed( SEED + 1 );
+	CHECK( random_at( 3, 17 ) != first );
+
+	random_set_seed( SEED );
+	CHECK( random_at( 3, 17 ) == first );
+
+	// Every stream and index its own number, and the top bits of all of them are fair
+	static u64 values[ STREAMS * INDICES ];
+	Buckets<16> top;
+
+	for ( u64 stream = 0; stream < STREAMS; ++stream )
+	{
+		for ( u64 index = 0; index < INDICES; ++index )
+		{
+			values[ stream * INDICES + index ] = random_at( stream, index );
+			top.add( random_at( stream, index ) >> 60 );
+		}
+	}
+
+	u32 repeats = 0;
+
+	for ( u64 i = 0; i < STREAMS * INDICES; ++i )
+	{
+		for ( u64 j = i + 1; j < STREAMS * INDICES; ++j )
+			repeats += values[ i ] == values[ j ];
+	}
+
+	CHECK( repeats == 0 );
+	CHECK( top.fair() );
+
+	// The streams aren't each other shifted along
+	u32 shifted = 0;
+
+	for ( u64 stream = 1; stream < STREAMS; ++stream )
+	{
+		for ( u64 index = 1; index < INDICES; ++index )
+			shifted += values[ stream * INDICES + index ] == values[ ( stream - 1 ) * INDICES + index - 1 ];
+	}
+
+	CHECK( shifted == 0 );
+
+	// Bounded, the same worst case for bias as bounded() and the whole 32 bits
+	constexpr u32 DRAWS = 120000;
+	constexpr u32 RANGE = UINT32_C( 3 ) << 30;
+
+	Buckets<6> dice;
+	Buckets<3> thirds;
+	Buckets<3> residues;
+	Buckets<16> whole;
+	bool inside = true;
+	u32 bits = 0;
+
+	for ( u32 i = 0; i < DRAWS; ++i )
+	{
+		u32 die = irandom_at( 7, i, 5 );
+		u32 x = irandom_at( 8, i, RANGE - 1 );
+		u32 y = irandom_at( 9, i, UINT32_MAX );
+
+		inside &= die <= 5 && x < RANGE;
+
+		dice.add( die );
+		thirds.add( x >> 30 );
+		residues.add( x % 3 );
+		whole.add( y >> 28 );
+		bits |= y;
+	}
+
+	CHECK( inside );
+	CHECK( dice.fair() );
+	CHECK( thirds.fair() );
+	CHECK( residues.fair() );
+	CHECK( whole.fair() );
+	CHECK( bits == UINT32_MAX );
+	CHECK( irandom_at( 9, 5, UINT32_MAX ) == static_cast<u32>( random_at( 9, 5 ) >> 32 ) );
+	CHECK( irandom_at( 9, 5, 0 ) == 0 );
+}
+
+// -------------------------------------------------------
+// proc, the f32 chance at runtime and the Chance made at compile time
+// -------------------------------------------------------
+
+static void test_proc()
+{
+	constexpr i32 DRAWS = 100000;
+
+	RandomStream random;
+	random.set_seed( SEED );
+
+	i32 never = 0;
+	i32 always = 0;
+	i32 quarter = 0;
+	i32 quarterChance = 0;
+	i32 tiny = 0;
+
+	for ( i32 i = 0; i < DRAWS; ++i )
+	{
+		never += random.proc( 0.f );
+		never += random.proc( -5.f );
+		always += random.proc( 100.f );
+		always += random.proc( 250.f );
+		quarter += random.proc( 25.f );
+		quarterChance += random.proc( chance_percent( 25 ) );
+		tiny += random.proc( 0.001f );
+	}
+
+	CHECK( never == 0 );
+	CHECK( always == DRAWS * 2 );
+
+	// 4 standard deviations either way
+	CHECK( quarter > DRAWS / 4 - 548 && quarter < DRAWS / 4 + 548 );
+	CHECK( quarterChance > DRAWS / 4 - 548 && quarterChance < DRAWS / 4 + 548 );
+	CHECK( tiny < 10 );
+
+	// The same draw gives the same answer either way, away from the edge of the threshold
+	RandomStream again = random;
+	bool same = true;
+
+	for ( i32 i = 0; i < 1000; ++i )
+		same &= random.proc( 37.5f ) == again.proc( chance_percent( 37.5 ) );
+
+	CHECK( same );
+}
+
+// -------------------------------------------------------
+// Alias tables, built at compile time
+// -------------------------------------------------------
+
+static constexpr f64 aliasWeights[] = { 1.0, 2.0, 3.0, 4.0, 0.5, 0.0, 9.5 };
+static constexpr AliasTable<sizeof( aliasWeights ) / sizeof( aliasWeights[ 0 ] )> aliasTable = make_alias_table( aliasWeights );
+
+static_assert( aliasTable.keep[ 5 ] == 0, "Never keeps an outcome with no weight" );
+
+static void test_alias_table()
+{
+	constexpr u32 N = sizeof( aliasWeights ) / sizeof( aliasWeights[ 0 ] );
+	constexpr i32 DRAWS = 200000;
+
+	RandomStream random;
+	random.set_seed( SEED );
+
+	u32 counts[ N ] = {};
+
+	for ( i32 i = 0; i < DRAWS; ++i )
+		counts[ random.choose( aliasTable ) ] += 1;
+
+	CHECK( counts[ 5 ] == 0 );
+
+	// Leave the empty outcome out of the chi-square, it has nothing expected
+	u32 seen[ N - 1 ];
+	f64 expected[ N - 1 ];
+	f64 total = 0;
+
+	for ( f64 weight : aliasWeights )
+		total += weight;
+
+	for ( u32 i = 0, j = 0; i < N; ++i )
+	{
+		if ( aliasWeights[ i ] == 0 )
+			continue;
+
+		seen[ j ] = counts[ i ];
+		expected[ j ] = DRAWS * aliasWeights[ i ] / total;
+		j += 1;
+	}
+
+	CHECK( chi_square( seen, N - 1, expected ) < chi_square_limit( N - 2 ) );
+
+	// One outcome is all of them
+	static constexpr f64 oneWeight[] = { 0.0, 1.0, 0.0 };
+	static constexpr AliasTable<3> oneTable = make_alias_table( oneWeight );
+
+	bool one = true;
+
+	for ( i32 i = 0; i < 1000; ++i )
+		one &= random.choose( oneTable ) == 1;
+
+	CHECK( one );
+}
+
+// -------------------------------------------------------
+// Subsets and shuffles, every index equally likely
+// -------------------------------------------------------
+
+static void test_random_subset()
+{
+	constexpr i32 DRAWS = 40000;
+
+	RandomStream random;
+	random.set_seed( SEED );
+
+	// Both sides of n / 2, where it picks the ones left out instead
+	const u32 sizes[][ 2 ] = { { 16, 3 }, { 16, 8 }, { 16, 13 }, { 64, 5 }, { 64, 60 }, { 7, 7 } };
+
+	for ( const u32 *size : sizes )
+	{
+		u32 n = size[ 0 ];
+		u32 k = size[ 1 ];
+		u32 counts[ 64 ] = {};
+		bool exact = true;
+
+		for ( i32 i = 0; i < DRAWS; ++i )
+		{
+			u64 subset = random.random_subset( n, k );
+
+			exact &= static_cast<u32>( __builtin_popcountll( subset ) ) == k;
+			exact &= n == 64 || ( subset >> n ) == 0;
+
+			for ( ; subset; subset &= subset - 1 )
+				counts[ __builtin_ctzll( subset ) ] += 1;
+		}
+
+		CHECK( exact );
+
+		// Every index turns up k / n of the time
+		if ( k < n )
+			CHECK( chi_square( counts, n, static_cast<f64>( DRAWS ) * k / n ) < chi_square_limit( n - 1 ) );
+	}
+
+	CHECK( random.random_subset( 16, 0 ) == 0 );
+	CHECK( random.random_subset( 64, 64 ) == UINT64_MAX );
+	CHECK( random.random_subset( 100, 100 ) == UINT64_MAX );
+}
+
+static void test_sample_k_of_n()
+{
+	constexpr i32 DRAWS = 40000;
+	constexpr u32 N = 16;
+	constexpr u32 K = 4;
+
+	RandomStream random;
+	random.set_seed( SEED );
+
+	// The order is random too, whatever index comes first is uniform
+	u32 first[ N ] = {};
+	bool distinct = true;
+
+	for ( i32 i = 0; i < DRAWS; ++i )
+	{
+		u8 out[ K ];
+		random.sample_k_of_n( out, K, N );
+
+		u32 seen = 0;
+
+		for ( u8 index : out )
+		{
+			distinct &= index < N && !( seen & 1 << index );
+			seen |= 1 << index;
+		}
+
+		first[ out[ 0 ] ] += 1;
+	}
+
+	CHECK( distinct );
+	CHECK( chi_square( first, N, static_cast<f64>( DRAWS ) / N ) < chi_square_limit( N - 1 ) );
+}
+
+static void test_shuffle()
+{
+	constexpr i32 DRAWS = 60000;
+
+	RandomStream random;
+	random.set_seed( SEED );
+
+	// All 6 orders of 3 equally likely
+	u32 orders[ 6 ] = {};
+
+	for ( i32 i = 0; i < DRAWS; ++i )
+	{
+		u8 items[ 3 ] = { 0, 1, 2 };
+		random.shuffle( items, 3 );
+
+		// Lehmer code, 0-5
+		u32 code = items[ 0 ] * 2 + ( items[ 1 ] > items[ 2 ] );
+		orders[ code ] += 1;
+	}
+
+	CHECK( chi_square( orders, 6, DRAWS / 6.0 ) < chi_square_limit( 5 ) );
+}
+
+// -------------------------------------------------------
+// Ziggurat, moments and the shape against the real distribution
+// -------------------------------------------------------
+
+static constexpr i32 VARIATES = 1000000;
+
+// Bucket edges in standard deviations, the last bucket is everything past the last edge
+static constexpr f64 normalEdges[] = { -3.5, -2.0, -1.0, -0.5, 0.0, 0.5, 1.0, 2.0, 3.5 };
+static constexpr f64 exponentialEdges[] = { 0.25, 0.5, 1.0, 2.0, 3.0, 5.0, 7.7 };
+
+template <u32 EDGES>
+static u32 bucket_of( f64 x, const f64 ( &edges )[ EDGES ] )
+{
+	u32 bucket = 0;
+
+	while ( bucket < EDGES && x >= edges[ bucket ] )
+		bucket += 1;
+
+	return bucket;
+}
+
+template <typename Engine>
+static void test_normal()
+{
+	constexpr u32 BUCKETS = sizeof( normalEdges ) / sizeof( normalEdges[ 0 ] ) + 1;
+
+	Random<Engine> random;
+	random.set_seed( SEED );
+
+	f64 sum = 0;
+	f64 squares = 0;
+	f64 cubes = 0;
+	f64 fourths = 0;
+	u32 counts[ BUCKETS ] = {};
+
+	for ( i32 i = 0; i < VARIATES; ++i )
+	{
+		f64 z = random.normal_q16() / 65536.0;
+
+		sum += z;
+		squares += z * z;
+		cubes += z * z * z;
+		fourths += z * z * z * z;
+		counts[ bucket_of( z, normalEdges ) ] += 1;
+	}
+
+	f64 mean = sum / VARIATES;
+	f64 variance = squares / VARIATES - mean * mean;
+
+	// About 5 standard errors each
+	CHECK( fabs( mean ) < 0.005 );
+	CHECK( fabs( variance - 1.0 ) < 0.007 );
+	CHECK( fabs( cubes / VARIATES ) < 0.015 );
+	CHECK( fabs( fourths / VARIATES - 3.0 ) < 0.05 );
+
+	f64 expected[ BUCKETS ];
+	f64 below = 0;
+
+	for ( u32 i = 0; i < BUCKETS; ++i )
+	{
+		f64 cdf = i < BUCKETS - 1 ? 0.5 * erfc( -normalEdges[ i ] / sqrt( 2.0 ) ) : 1.0;
+		expected[ i ] = ( cdf - below ) * VARIATES;
+		below = cdf;
+	}
+
+	// The outer buckets are past r, only the tail draws land there
+	CHECK( chi_square( counts, BUCKETS, expected ) < chi_square_limit( BUCKETS - 1 ) );
+}
+
+template <typename Engine>
+static void test_exponential()
+{
+	constexpr u32 BUCKETS = sizeof( exponentialEdges ) / sizeof( exponentialEdges[ 0 ] ) + 1;
+
+	Random<Engine> random;
+	random.set_seed( SEED );
+
+	f64 sum = 0;
+	f64 squares = 0;
+	u32 counts[ BUCKETS ] = {};
+	bool positive = true;
+
+	for ( i32 i = 0; i < VARIATES; ++i )
+	{
+		i32 q16 = random.exponential_q16();
+		f64 x = q16 / 65536.0;
+
+		positive &= q16 >= 0;
+		sum += x;
+		squares += x * x;
+		counts[ bucket_of( x, exponentialEdges ) ] += 1;
+	}
+
+	f64 mean = sum / VARIATES;
+	f64 variance = squares / VARIATES - mean * mean;
+
+	CHECK( positive );
+	CHECK( fabs( mean - 1.0 ) < 0.005 );
+	CHECK( fabs( variance - 1.0 ) < 0.015 );
+
+	f64 expected[ BUCKETS ];
+	f64 below = 0;
+
+	for ( u32 i = 0; i < BUCKETS; ++i )
+	{
+		f64 cdf = i < BUCKETS - 1 ? 1.0 - exp( -exponentialEdges[ i ] ) : 1.0;
+		expected[ i ] = ( cdf - below ) * VARIATES;
+		below = cdf;
+	}
+
+	CHECK( chi_square( counts, BUCKETS, expected ) < chi_square_limit( BUCKETS - 1 ) );
+}
+
+template <typename Engine>
+static void test_ziggurat()
+{
+	test_normal<Engine>();
+	test_exponential<Engine>();
+}
+
+// -------------------------------------------------------
+// next64() from a 32 bit engine is the first word high and the second low
+// -------------------------------------------------------
+
+template <typename Engine>
+static void test_next64_order()
+{
+	Random<Engine> random;
+	random.set_seed( SEED );
+
+	Engine copy = random.engine;
+
+	for ( i32 i = 0; i < 16; ++i )
+	{
+		u64 high = copy.next32();
+		u64 low = copy.next32();
+
+		CHECK( random.engine.next64() == ( ( high << 32 ) | low ) );
+	}
+}
+
+static void test_pool_next64_order()
+{
+	RandomStream source;
+	source.set_seed( SEED );
+
+	RandomStream expected = source;
+
+	// From the ring
+	PooledRandom pool;
+	pool.engine.init( &source, source.engine );
+	pool.engine.refill( 2 );
+
+	u64 high = expected.engine.next32();
+	u64 low = expected.engine.next32();
+
+	CHECK( pool.engine.next64() == ( ( high << 32 ) | low ) );
+
+	// Empty, so from the fallback
+	RandomEngine fallback = pool.engine.fallback;
+	high = fallback.next32();
+	low = fallback.next32();
+
+	CHECK( pool.engine.next64() == ( ( high << 32 ) | low ) );
+	CHECK( pool.engine.hits == 2 && pool.engine.misses == 2 );
+}
+
+// -------------------------------------------------------
+// The irandom wrappers, inclusive bounds either way round and negative ranges
+// -------------------------------------------------------
+
+static void test_irandom()
+{
+	RandomStream random;
+	random.set_seed( SEED );
+
+	Buckets<7> range;
+	Buckets<4> negative;
+	Buckets<5> range64;
+	bool inside = true;
+
+	for ( i32 i = 0; i < 28000; ++i )
+	{
+		i32 a = random.irandom_range( 3, -3 );
+		i32 b = random.irandom( -3 );
+		i64 c = random.irandom_range( INT64_C( -2 ), INT64_C( 2 ) );
+		u32 d = random.irandom_range( UINT32_MAX - 1, UINT32_MAX );
+
+		inside &= a >= -3 && a <= 3;
+		inside &= b >= -3 && b <= 0;
+		inside &= c >= -2 && c <= 2;
+		inside &= d >= UINT32_MAX - 1;
+
+		if ( !inside )
+			break;
+
+		range.add( a + 3 );
+		negative.add( -b );
+		range64.add( c + 2 );
+	}
+
+	CHECK( inside );
+	CHECK( range.fair() );
+	CHECK( negative.fair() );
+	CHECK( range64.fair() );
+
+	CHECK( random.irandom( 0u ) == 0 );
+	CHECK( random.irandom_range( 7, 7 ) == 7 );
+
+	// The whole of u32 doesn't overflow to a range of 0 and hang or return 0
+	u32 bits = 0;
+
+	for ( i32 i = 0; i < 64; ++i )
+		bits |= random.irandom( UINT32_MAX );
+
+	CHECK( bits == UINT32_MAX );
+
+	// Same seed, same numbers
+	RandomStream again;
+	again.set_seed( SEED );
+	random.set_seed( SEED );
+
+	bool same = true;
+
+	for ( i32 i = 0; i < 1000; ++i )
+		same &= random.irandom( 99u ) == again.irandom( 99u );
+
+	CHECK( same );
+}
+
+// -------------------------------------------------------
+// Snapshots of the global streams
+// -------------------------------------------------------
+
+static void draw_streams( u32 *out, i32 count )
+{
+	for ( i32 i = 0; i < count; ++i )
+	{
+		for ( i32 s = 0; s < static_cast<i32>( RANDOM_STREAM::COUNT ); ++s )
+			*out++ = random_stream( static_cast<RANDOM_STREAM>( s ) )->engine.next32();
+
+		*out++ = static_cast<u32>( random_at( 1, i ) );
+	}
+}
+
+static void test_state()
+{
+	constexpr i32 DRAWS = 32;
+	constexpr i32 WORDS = DRAWS * ( static_cast<i32>( RANDOM_STREAM::COUNT ) + 1 );
+
+	random_set_seed( SEED );
+
+	u32 skipped[ WORDS ];
+	u32 first[ WORDS ];
+	u32 second[ WORDS ];
+
+	draw_streams( skipped, DRAWS );
+
+	// Carries on from where the streams are, not back at the seed
+	RandomState state;
+	random_get_state( &state );
+
+	draw_streams( first, DRAWS );
+
+	random_set_state( state );
+
+	draw_streams( second, DRAWS );
+
+	CHECK( memcmp( first, second, sizeof( first ) ) == 0 );
+	CHECK( memcmp( first, skipped, sizeof( first ) ) != 0 );
+
+	// The seed starts them all over
+	u64 seed[ RANDOM_SEED_WORDS ];
+	random_get_seed( seed );
+	random_set_seed( seed );
+
+	draw_streams( second, DRAWS );
+
+	CHECK( memcmp( skipped, second, sizeof( skipped ) ) == 0 );
+}
+
+// advance() is next() called delta times, and the jumps land on unrelated increments. Increments a
+// few apart give streams that are the same sequence shifted, so every pair must differ in about
+// half their bits.
+static void test_pcg32_jump()
+{
+	Splitmix64 splitmix { SEED };
+	Pcg32 stepped;
+	stepped.seed( &splitmix );
+
+	Pcg32 advanced = stepped;
+
+	static constexpr u64 DELTAS[] = { 0, 1, 7, 1000, 4096 };
+
+	for ( u64 delta : DELTAS )
+	{
+		for ( u64 i = 0; i < delta; ++i )
+			stepped.next();
+
+		advanced.advance( delta );
+
+		CHECK( advanced.state == stepped.state );
+	}
+
+	// A whole period comes back round
+	Pcg32 period = stepped;
+	period.advance( 0 - UINT64_C( 1 ) );
+	period.next();
+	CHECK( period.state == stepped.state );
+
+	constexpr i32 STREAMS = 64;
+	u64 increments[ STREAMS ];
+	Pcg32 engine = stepped;
+
+	for ( i32 i = 0; i < STREAMS; ++i )
+	{
+		increments[ i ] = engine.increment;
+		CHECK( engine.increment & 1 );
+
+		if ( i % 2 )
+		{
+			engine.long_jump();
+		}
+		else
+		{
+			Pcg32 before = engine;
+			before.advance( UINT64_C( 1 ) << 32 );
+			engine.jump();
+			CHECK( engine.state == before.state );
+		}
+	}
+
+	i32 closest = 64;
+
+	for ( i32 i = 0; i < STREAMS; ++i )
+	{
+		for ( i32 j = i + 1; j < STREAMS; ++j )
+		{
+			i32 bits = __builtin_popcountll( increments[ i ] ^ increments[ j ] );
+			closest = bits < closest ? bits : closest;
+		}
+	}
+
+	CHECK( closest >= 12 );
+}
+
+static void test_stream_state()
+{
+	random_set_seed( SEED );
+
+	RandomStream *core1 = random_stream( RANDOM_STREAM::CORE1 );
+	RandomStream *pooled = random_stream( RANDOM_STREAM::POOL );
+
+	u64 state[ RandomEngine::STATE_WORDS ];
+	random_get_state( RANDOM_STREAM::CORE1, state );
+
+	u32 core0 = random_stream( RANDOM_STREAM::CORE0 )->engine.next32();
+	u32 first = core1->engine.next32();
+
+	random_set_state( RANDOM_STREAM::CORE1, state );
+
+	CHECK( core1->engine.next32() == first );
+	CHECK( random_stream( RANDOM_STREAM::CORE0 )->engine.next32() != core0 );
+
+	// Restoring the pooled stream throws away what was queued from it
+	CHECK( random_pool()->engine.source == pooled );
+
+	u64 pooledState[ RandomEngine::STATE_WORDS ];
+	pooled->engine.get_state( pooledState );
+
+	random_pool_refill( 8 );
+
+	random_set_state( RANDOM_STREAM::POOL, pooledState );
+
+	CHECK( random_pool()->engine.words.empty() );
+
+	RandomEngine expected = pooled->engine;
+	random_pool_refill( 1 );
+
+	CHECK( random_pool()->engine.next32() == expected.next32() );
+}
+
+// Core1 refilling the pool flat out while core0 reseeds, nothing made from a previous seed
+// turns up after the reseed
+static void test_reseed_with_producer()
+{
+	constexpr i32 SEEDS = 16;
+	constexpr i32 RESEEDS = 100;
+	constexpr i32 WORDS = 8;
+
+	RandomEngine expected[ SEEDS ];
+
+	for ( i32 i = 0; i < SEEDS; ++i )
+	{
+		random_set_seed( SEED + i );
+		expected[ i ] = random_stream( RANDOM_STREAM::POOL )->engine;
+	}
+
+	std::atomic<bool> stop( false );
+
+	std::thread core1( [ &stop ]()
+	{
+		while ( !stop )
+			random_pool_refill( RandomPool::REFILL_BLOCK );
+	} );
+
+	RandomPool *pool = &random_pool()->engine;
+	bool same = true;
+
+	for ( i32 i = 0; i < RESEEDS && same; ++i )
+	{
+		random_set_seed( SEED + i % SEEDS );
+
+		RandomEngine engine = expected[ i % SEEDS ];
+
+		for ( i32 w = 0; w < WORDS; ++w )
+		{
+			u32 word;
+
+			while ( !pool->words.pop( &word ) )
+				std::this_thread::yield();
+
+			same &= word == engine.next32();
+		}
+	}
+
+	stop = true;
+	core1.join();
+
+	CHECK( same );
+}
+
+// -------------------------------------------------------
+// Benchmarks, ns per number on this machine. Only the ratios say anything about the m0+.
+// -------------------------------------------------------
+
+static void benchmark_bounded()
+{
+	constexpr i32 NUMBERS = 10000000;
+
+	RandomStream random;
+	random.set_seed( SEED );
+
+	u64 sum = 0;
+	f64 start = time_ns();
+
+	for ( i32 i = 0; i < NUMBERS; ++i )
+		sum += static_cast<u32>( random.random_f32_0_1() * 100 );
+
+	f64 floatScaled = ( time_ns() - start ) / NUMBERS;
+
+	start = time_ns();
+
+	for ( i32 i = 0; i < NUMBERS; ++i )
+		sum += random.irandom( 99u );
+
+	f64 bounded32 = ( time_ns() - start ) / NUMBERS;
+
+	start = time_ns();
+
+	for ( i32 i = 0; i < NUMBERS; ++i )
+		sum += random.irandom( ( UINT64_C( 3 ) << 62 ) - 1 );
+
+	f64 bounded64 = ( time_ns() - start ) / NUMBERS;
+
+	benchmarkSink = sum;
+
+	printf( "irandom( 99 ) float scaled      %6.2f ns\n", floatScaled );
+	printf( "irandom( 99 )                   %6.2f ns\n", bounded32 );
+	printf( "irandom( 3 << 62 - 1 )          %6.2f ns\n", bounded64 );
+}
+
+// 8 of 16 pads, the positions loop level generation used to have against random_subset
+static void benchmark_subset()
+{
+	constexpr i32 SUBSETS = 1000000;
+
+	RandomStream random;
+	random.set_seed( SEED );
+
+	u64 sum = 0;
+	f64 start = time_ns();
+
+	for ( i32 i = 0; i < SUBSETS; ++i )
+	{
+		u8 positions[ 16 ] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+		i32 positionsCount = 15;
+		u32 subset = 0;
+
+		for ( i32 picks = 8; picks > 0; --picks )
+		{
+			// The float irandom_range( 0, positionsCount ) it called
+			i32 r = static_cast<i32>( random.random_f32_0_1() * ( positionsCount + 1 ) );
+			subset |= 1 << positions[ r ];
+			positions[ r ] = positions[ positionsCount-- ];
+		}
+
+		sum += subset;
+	}
+
+	f64 loop = ( time_ns() - start ) / SUBSETS;
+
+	start = time_ns();
+
+	for ( i32 i = 0; i < SUBSETS; ++i )
+		sum += random.random_subset( 16, 8 );
+
+	f64 bitmask = ( time_ns() - start ) / SUBSETS;
+
+	benchmarkSink = sum;
+
+	printf( "8 of 16 positions loop          %6.2f ns\n", loop );
+	printf( "8 of 16 random_subset           %6.2f ns\n", bitmask );
+}
+
+template <typename Engine>
+static void benchmark_engine( const char *name )
+{
+	constexpr i32 NUMBERS = 10000000;
+
+	Random<Engine> random;
+	random.set_seed( SEED );
+
+	u64 sum = 0;
+	f64 start = time_ns();
+
+	for ( i32 i = 0; i < NUMBERS; ++i )
+		sum += random.engine.next32();
+
+	f64 next32 = ( time_ns() - start ) / NUMBERS;
+
+	start = time_ns();
+
+	for ( i32 i = 0; i < NUMBERS; ++i )
+		sum += random.engine.next64();
+
+	f64 next64 = ( time_ns() - start ) / NUMBERS;
+
+	start = time_ns();
+
+	for ( i32 i = 0; i < NUMBERS; ++i )
+		sum += random.normal_q16();
+
+	f64 normal = ( time_ns() - start ) / NUMBERS;
+
+	benchmarkSink = sum;
+
+	printf( "%-20s next32 %6.2f ns  next64 %6.2f ns  normal_q16 %6.2f ns\n", name, next32, next64, normal );
+}
+
+int main()
+{
+	test_bounded<Xoshiro256starstar>();
+	test_bounded<Xoshiro256plus>();
+	test_bounded<Xoshiro128starstar>();
+	test_bounded<Xoshiro128plus>();
+	test_bounded<Pcg32>();
+	test_random_at();
+	test_next64_order<Xoshiro128starstar>();
+	test_next64_order<Xoshiro128plus>();
+	test_next64_order<Pcg32>();
+	test_pool_next64_order();
+	test_irandom();
+	test_proc();
+	test_alias_table();
+	test_random_subset();
+	test_sample_k_of_n();
+	test_shuffle();
+	test_ziggurat<Xoshiro256starstar>();
+	test_ziggurat<Xoshiro256plus>();
+	test_ziggurat<Xoshiro128starstar>();
+	test_ziggurat<Xoshiro128plus>();
+	test_ziggurat<Pcg32>();
+	test_state();
+	test_stream_state();
+	test_pcg32_jump();
+	test_reseed_with_producer();
+
+	benchmark_bounded();
+	benchmark_subset();
+	benchmark_engine<Xoshiro256starstar>( "xoshiro256**" );
+	benchmark_engine<Xoshiro256plus>( "xoshiro256+" );
+	benchmark_engine<Xoshiro128starstar>( "xoshiro128**" );
+	benchmark_engine<Xoshiro128plus>( "xoshiro128+" );
+	benchmark_engine<Pcg32>( "pcg32" );
+
+	return check_result( "random" );
+}
@@ -0,0 +1,121 @@
+#include <stdint.h>
+
+#include "check.h"
+#include "random.h"
+#include "random_lanes.h"
+
+static constexpr u64 SEED = 0x5EED;
+static constexpr u32 LANES = 8;
+
+// Lane n is the scalar engine jumped n times, a number at a time and through fill()
+static void test_lanes_match_scalar()
+{
+	Splitmix64 splitmix { SEED };
+	Xoshiro256plus base;
+	base.seed( &splitmix );
+
+	Xoshiro256plusLanes<LANES> lanes;
+	lanes.seed( base );
+
+	Xoshiro256plus scalar[ LANES ];
+	Xoshiro256plus engine = base;
+
+	for ( Xoshiro256plus &lane : scalar )
+	{
+		lane = engine;
+		engine.jump();
+	}
+
+	bool same = true;
+
+	for ( i32 step = 0; step < 1000; ++step )
+	{
+		u64 out[ LANES ];
+		lanes.next( out );
+
+		for ( u32 lane = 0; lane < LANES; ++lane )
+			same &= out[ lane ] == scalar[ lane ].next();
+	}
+
+	CHECK( same );
+
+	// Interleaved, and a partial last step still moves every lane on
+	constexpr u64 COUNT = LANES * 5 + 3;
+
+	u64 filled[ COUNT ];
+	lanes.fill( filled, COUNT );
+
+	for ( u64 i = 0; i < COUNT; ++i )
+		same &= filled[ i ] == scalar[ i % LANES ].next();
+
+	for ( u32 lane = 3; lane < LANES; ++lane )
+		scalar[ lane ].next();
+
+	u64 out[ LANES ];
+	lanes.next( out );
+
+	for ( u32 lane = 0; lane < LANES; ++lane )
+		same &= out[ lane ] == scalar[ lane ].next();
+
+	CHECK( same );
+}
+
+// GB/s of numbers from one scalar engine and from the lanes
+static void benchmark_lanes()
+{
+	constexpr u64 BLOCK = LANES * 256;
+	constexpr u64 NUMBERS = UINT64_C( 1 ) << 26;
+
+	static u64 block[ BLOCK ];
+
+	Splitmix64 splitmix { SEED };
+	Xoshiro256plus scalar;
+	Xoshiro256plusLanes<LANES> lanes;
+
+	scalar.seed( &splitmix );
+	lanes.seed( scalar );
+
+	u64 sum = 0;
+	f64 start = time_ns();
+
+	for ( u64 i = 0; i < NUMBERS; i += BLOCK )
+	{
+		for ( u64 j = 0; j < BLOCK; ++j )
+			block[ j ] = scalar.next();
+
+		sum += block[ BLOCK - 1 ];
+	}
+
+	f64 middle = time_ns();
+
+	for ( u64 i = 0; i < NUMBERS; i += BLOCK )
+	{
+		lanes.fill( block, BLOCK );
+
+		sum += block[ BLOCK - 1 ];
+	}
+
+	f64 end = time_ns();
+
+	benchmarkSink = sum;
+
+	f64 bytes = static_cast<f64>( NUMBERS * sizeof( u64 ) );
+
+	#ifdef __AVX2__
+		const char *kind = "avx2";
+	#else
+		const char *kind = "scalar";
+	#endif
+
+	printf( "xoshiro256+ scalar              %6.2f GB/s\n", bytes / ( middle - start ) );
+	printf( "xoshiro256+ %u lanes %-6s      %6.2f GB/s\n", LANES, kind, bytes / ( end - middle ) );
+}
+
+int main()
+{
+	test_lanes_match_scalar();
+
+	benchmark_lanes();
+
+	return check_result( "random_lanes" );
+}
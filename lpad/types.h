@@ -23,6 +23,9 @@ static_assert( sizeof( u64 ) == 8 );
 static_assert( sizeof( f32 ) == 4 );
 static_assert( sizeof( f64 ) == 8 );
 
+// Signed, so it compares with the i32 loop counters without a warning
+#define ARRAY_LENGTH( arr )		static_cast<i32>( sizeof( arr ) / sizeof( arr[ 0 ] ) )
+
 struct Colour
 {
 	u8 r;
@@ -1,7 +1,11 @@
 
 #include <math.h>
 
-#include "pico/stdlib.h"
+#ifdef LPAD_HOST
+	#include <stdint.h>
+#else
+	#include "pico/stdlib.h"
+#endif
 
 #include "utility.h"
 
@@ -10,7 +14,7 @@
 	return { static_cast<u8>( a * 31 ), static_cast<u8>( b * 31 ), static_cast<u8>( c * 31 ) };
 }
 
-[[nodiscard]] Colour rgb_to_hsv( Colour colourIn )
+[[nodiscard]] Colour rgb_to_hsv_reference( Colour colourIn )
 {
 	f32 r = colourIn.r / 31.f;
 	f32 g = colourIn.g / 31.f;
@@ -68,7 +72,7 @@
 	return make_colour( h, s, v );
 }
 
-[[nodiscard]] Colour hsv_to_rgb( Colour colourIn )
+[[nodiscard]] Colour hsv_to_rgb_reference( Colour colourIn )
 {
 	f32 h = colourIn.r / 31.f;
 	f32 s = colourIn.g / 31.f;
@@ -132,4 +136,111 @@
 	}
 
 	return make_colour( r, g, b );
-}
\ No newline at end of file
+}
+// -------------------------------------------------------
+// Integer versions, exact maths floored the same as make_colour
+// -------------------------------------------------------
+
+// The channels at full saturation and value for each of the 32 hues, out of 31. Built from the
+// same six sectors as the float version, hue 31 lands in the last sector just like it does there.
+struct HueWheel
+{
+	Colour hues[ 32 ];
+};
+
+static constexpr HueWheel make_hue_wheel()
+{
+	HueWheel wheel = {};
+
+	for ( u32 h = 0; h < 32; ++h )
+	{
+		u32 sector = ( h * 6 ) / 31;
+		u8 f = static_cast<u8>( ( h * 6 ) % 31 );			// how far through the sector, out of 31
+		u8 rising = f;
+		u8 falling = static_cast<u8>( 31 - f );
+
+		switch ( sector )
+		{
+		case 0: wheel.hues[ h ] = { 31, rising, 0 }; break;
+		case 1: wheel.hues[ h ] = { falling, 31, 0 }; break;
+		case 2: wheel.hues[ h ] = { 0, 31, rising }; break;
+		case 3: wheel.hues[ h ] = { 0, falling, 31 }; break;
+		case 4: wheel.hues[ h ] = { rising, 0, 31 }; break;
+		default: wheel.hues[ h ] = { 31, 0, falling }; break;
+		}
+	}
+
+	return wheel;
+}
+
+static constexpr HueWheel hueWheel = make_hue_wheel();
+
+// x / 961 for every x a channel can reach (31 * 31 * 31), as a multiply and shift
+static constexpr u32 div_961( u32 x )
+{
+	return ( x * 34917 ) >> 25;
+}
+
+static constexpr bool check_div_961()
+{
+	for ( u32 x = 0; x <= 31 * 961; ++x )
+	{
+		if ( div_961( x ) != x / 961 )
+			return false;
+	}
+
+	return true;
+}
+
+static_assert( check_div_961() );
+
+// v * ( 1 - s * ( 1 - c ) ) with everything out of 31
+static inline u8 hsv_channel( u32 c, u32 s, u32 v )
+{
+	return static_cast<u8>( div_961( v * ( 961 - s * ( 31 - c ) ) ) );
+}
+
+[[nodiscard]] Colour hsv_to_rgb( Colour colourIn )
+{
+	// The float version treats a hue past the wheel as 0
+	const Colour &hue = hueWheel.hues[ colourIn.r < 32 ? colourIn.r : 0 ];
+	u32 s = colourIn.g;
+	u32 v = colourIn.b;
+
+	return { hsv_channel( hue.r, s, v ), hsv_channel( hue.g, s, v ), hsv_channel( hue.b, s, v ) };
+}
+
+[[nodiscard]] Colour rgb_to_hsv( Colour colourIn )
+{
+	i32 r = colourIn.r;
+	i32 g = colourIn.g;
+	i32 b = colourIn.b;
+
+	i32 min = r < g ? r : g;
+	min = min < b ? min : b;
+
+	i32 max = r > g ? r : g;
+	max = max > b ? max : b;
+
+	i32 delta = max - min;
+
+	if ( delta == 0 )
+		return { 0, 0, static_cast<u8>( max ) };
+
+	// Hue as sixths of delta around the wheel
+	i32 hue;
+
+	if ( r >= max )
+		hue = g - b < 0 ? g - b + 6 * delta : g - b;
+	else if ( g >= max )
+		hue = 2 * delta + b - r;
+	else
+		hue = 4 * delta + r - g;
+
+	return
+	{
+		static_cast<u8>( ( hue * 31 ) / ( 6 * delta ) ),
+		static_cast<u8>( ( delta * 31 ) / max ),
+		static_cast<u8>( max ),
+	};
+}
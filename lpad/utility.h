@@ -3,5 +3,12 @@
 
 #include "types.h"
 
+// Components are all 5 bit (0-31), hsv is packed into a Colour as { h, s, v }.
+// Integer only, for every tick.
 [[nodiscard]] Colour rgb_to_hsv( Colour colour );
-[[nodiscard]] Colour hsv_to_rgb( Colour colour );
\ No newline at end of file
+[[nodiscard]] Colour hsv_to_rgb( Colour colour );
+
+// The original float versions, kept as the reference the integer ones are checked against
+// (tests/test_colour.cpp)
+[[nodiscard]] Colour rgb_to_hsv_reference( Colour colour );
+[[nodiscard]] Colour hsv_to_rgb_reference( Colour colour );
\ No newline at end of file